@@ -1,4 +1,15 @@
 #include "Source/src.cpp"
+#include "Source/map.cpp"
+#include "Source/mesh.cpp"
+#include "Source/codec.cpp"
+#include "Source/save.cpp"
+#include "Source/replay.cpp"
+#include "Source/pregen.cpp"
+#include "Source/jobs.cpp"
+#include "Source/sim.cpp"
+#include "Source/lod.cpp"
+#include "Source/scheduler.cpp"
+#include "Source/coroutine.cpp"
 
 using namespace sf;
 
@@ -7,13 +18,6 @@ using namespace sf;
 void init() {
     textures.load("assets/textures/include.txt");
 
-    /**
-     * заполнением параметров уровня сложности
-     */
-    difficulties[0] = {"Easy", 10, 8};
-    difficulties[1] = {"Medium", 20, 10};
-    difficulties[2] = {"Hard", 70, 20};
-
     /**
      * погружаем шрифт
      */
@@ -23,6 +27,16 @@ void init() {
      * добавляем меню как активное состояние игры
      */
     states.insert("menu", std::shared_ptr<alone::State>(new MenuState()));
+
+    /**
+     * пока игрок в меню, в фоне уже готовятся карты
+     */
+    boards.start();
+
+    /**
+     * кадр ждёт обновления экрана, остаток до него отдаётся отложенным задачам
+     */
+    window.setVerticalSyncEnabled(true);
 }
 
 struct LRM {
@@ -87,6 +101,7 @@ int main() {
 
     music.play();
     while (window.isOpen()) {
+        frames.beginFrame();
 
         /**
          * это проверка ивентов самого окна
@@ -99,6 +114,7 @@ int main() {
                  * если окно было закрыто
                  */
                 case sf::Event::Closed:
+                    states.close();
                     window.close();
                     break;
 
@@ -107,6 +123,22 @@ int main() {
                      */
                 case sf::Event::Resized:
                     window.setView(sf::View(sf::FloatRect(0, 0, event.size.width, event.size.height)));
+                    states.resize(sf::Vector2u(event.size.width, event.size.height));
+                    break;
+
+                    /**
+                     * нажатия клавиш копятся до следующего обновления ввода
+                     */
+                case sf::Event::KeyPressed:
+                    alone::input::press(event.key.code);
+                    break;
+
+                    /**
+                     * колесо мыши приближает карту
+                     */
+                case sf::Event::MouseWheelScrolled:
+                    if (event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel)
+                        alone::input::scroll(event.mouseWheelScroll.delta);
                     break;
             }
         }
@@ -120,17 +152,31 @@ int main() {
          * обновляем ввод
          */
         alone::input::update();
+        frames.lap(alone::FrameScheduler::Phase::Input);
 
         /**
          * а затем все состояния
          */
         states.update();
 
+        /**
+         * поверх всего статистика кадра, если включена
+         */
+        overlay.update(frames.stats());
+        window.draw(overlay);
+        frames.lap(alone::FrameScheduler::Phase::Draw);
+
+        /**
+         * что осталось от кадра - отложенным задачам
+         */
+        frames.runIdle();
+
         /**
          * выводим на экран
          */
         window.display();
     }
 
+    boards.stop();
     return 0;
-}
\ No newline at end of file
+}
\ No newline at end of file
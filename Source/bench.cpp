@@ -0,0 +1,619 @@
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <map>
+#include <set>
+#include <thread>
+
+#include "map.h"
+#include "mesh.h"
+#include "fixed_map.h"
+#include "codec.h"
+#include "replay.h"
+#include "save.h"
+#include "perf.h"
+#include "jobs.h"
+#include "lod.h"
+
+/**
+ *  замеры скорости работы карты
+    запускается отдельно от игры, окно не создаётся
+ */
+
+/**
+ * счётчики процессора, если их нет, то measure печатает только время
+ */
+static perf::Counters counters;
+
+/**
+ *  замер среднего времени одного вызова и, если можно, счётчиков процессора на вызов
+    так видно не только что стало быстрее, но и почему, например меньше промахов кэша после смены раскладки
+ *  @param prepare вызывается перед каждым замером и не входит ни во время, ни в счётчики
+ */
+static void measure(const std::string &name, size_t reps, const std::function<void()> &prepare,
+                    const std::function<void()> &body) {
+    std::chrono::nanoseconds total(0);
+    perf::values_t values{};
+    for (size_t i = 0; i != reps; i++) {
+        prepare();
+        auto begin = std::chrono::steady_clock::now();
+        counters.start();
+        body();
+        counters.stop(values);
+        total += std::chrono::steady_clock::now() - begin;
+    }
+    std::cout << std::left << std::setw(40) << name
+              << std::right << std::setw(14) << total.count() / reps << " ns";
+
+    for (size_t i = 0; i != perf::Count; i++)
+        if (counters.has((perf::Event) i))
+            std::cout << "  " << perf::Names[i] << ' ' << values[i] / reps;
+    if (counters.has(perf::Cycles) && counters.has(perf::Instructions) && values[perf::Cycles])
+        std::cout << "  IPC " << std::setprecision(2) << (double) values[perf::Instructions] / values[perf::Cycles];
+    std::cout << '\n';
+}
+
+/**
+ * чтобы компилятор не выкинул подсчёт соседей
+ */
+static volatile size_t guard;
+
+static const char *layoutName(Map::Layout layout) {
+    return layout == Map::Layout::RowMajor ? "row-major" : "tiled";
+}
+
+/**
+ * сравнение раскладок на одной и той же карте
+ */
+static void benchLayouts(size_t size, size_t bombs) {
+    std::cout << "board " << size << 'x' << size << ", " << bombs << " bombs\n";
+
+    for (auto layout: {Map::Layout::RowMajor, Map::Layout::Tiled}) {
+        std::string suffix = std::string(" [") + layoutName(layout) + "]";
+        sf::Vector2u center(size / 2, size / 2);
+
+        Map pristine;
+        pristine.resize(size, layout);
+        pristine.generate(bombs, center, 42);
+
+        Map map;
+        map.resize(size, layout);
+        measure("generate" + suffix, 5, [] {}, [&] {
+            map.generate(bombs, center, 42);
+        });
+
+        size_t sink = 0;
+        measure("_DetectAround (all tiles)" + suffix, 5, [] {}, [&] {
+            for (size_t y = 0; y != size; y++)
+                for (size_t x = 0; x != size; x++)
+                    sink += pristine._DetectAround(x, y);
+        });
+
+        measure("_OpenTiles" + suffix, 5, [&] { map = pristine; }, [&] {
+            map._OpenTiles(center.x, center.y);
+        });
+
+        /**
+         * постепенное открытие: та же заливка кусками по 4096 клеток и самый долгий кусок, то есть задержка кадра
+         */
+        double slice = 0;
+        measure("_OpenTiles progressive" + suffix, 5, [&] { map = pristine; map.setProgressive(true); }, [&] {
+            map._OpenTiles(center.x, center.y);
+            do {
+                auto begin = std::chrono::steady_clock::now();
+                map.step(4096);
+                std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - begin;
+                slice = std::max(slice, took.count());
+            } while (map.flooding());
+        });
+        std::cout << "  longest slice " << slice << " ms\n";
+
+        sf::VertexArray region(sf::Quads);
+        measure("buildMesh (hidden)" + suffix, 5, [] {}, [&] {
+            buildMesh(pristine, region, 100);
+        });
+        measure("buildMesh (opened)" + suffix, 5, [] {}, [&] {
+            buildMesh(map, region, 100);
+        });
+        measure("buildMesh (opened, pool)" + suffix, 5, [] {}, [&] {
+            buildMesh(map, region, 100, alone::JobSystem::shared());
+        });
+        measure("retextureMesh (opened, pool)" + suffix, 5, [] {}, [&] {
+            retextureMesh(map, region, alone::JobSystem::shared());
+        });
+
+        guard = sink;
+    }
+    std::cout << '\n';
+}
+
+/**
+ *  одна партия бота, который тыкает в случайные закрытые клетки
+    игра заканчивается на первой бомбе или когда все безопасные клетки открыты
+ *  @return количество кликов
+ */
+template<Board B>
+static size_t playRandom(B &board, size_t bombs, Random &rng) {
+    size_t size = board.size();
+    sf::Vector2u first(rng.upTo(size - 1), rng.upTo(size - 1));
+    board.generate(bombs, first, rng());
+    board._OpenTiles(first.x, first.y);
+
+    size_t clicks = 1;
+    for (size_t attempt = 0; attempt != size * size && board.hiddenSafe() != 0; attempt++) {
+        size_t x = rng.upTo(size - 1), y = rng.upTo(size - 1);
+        auto &tile = board.at(x, y);
+        if (tile.first == 'r')
+            continue;
+
+        clicks++;
+        if (tile.second == Type::Bomb)
+            break;
+        if (tile.second == Type::None)
+            board._OpenTiles(x, y);
+        else
+            board._SetState(x, y, 'r');
+    }
+    return clicks;
+}
+
+/**
+ * сравнение карты фиксированного размера с обычной на партиях бота
+ */
+template<class Fixed>
+static void benchFixed(const std::string &name, size_t games) {
+    Random rng(1);
+    size_t clicks = 0;
+
+    Map map;
+    map.resize(Fixed::size(), Map::Layout::RowMajor);
+    measure(name + " games [Map]", 1, [] {}, [&] {
+        for (size_t i = 0; i != games; i++)
+            clicks += playRandom(map, Fixed::mines(), rng);
+    });
+
+    Fixed fixed;
+    measure(name + " games [FixedMap]", 1, [] {}, [&] {
+        for (size_t i = 0; i != games; i++)
+            clicks += playRandom(fixed, Fixed::mines(), rng);
+    });
+
+    guard = clicks;
+    std::cout << "  (" << games << " games per run)\n";
+}
+
+/**
+ * скорость и размер сжатой записи карты
+ */
+static void benchCodec(size_t size, size_t bombs) {
+    Map map, loaded;
+    map.resize(size, Map::Layout::RowMajor);
+    map.generate(bombs, sf::Vector2u(size / 2, size / 2), 3);
+    map._OpenTiles(size / 2, size / 2);
+
+    std::vector<uint8_t> data;
+    size_t reps = size <= 64 ? 100000 : 10;
+    std::string name = std::to_string(size) + "x" + std::to_string(size);
+
+    measure("codec::encode " + name, reps, [&] { data.clear(); }, [&] {
+        codec::encode(map, data);
+    });
+    measure("codec::decode " + name, reps, [] {}, [&] {
+        const uint8_t *it = data.data();
+        codec::decode(it, data.data() + data.size(), loaded);
+    });
+
+    size_t raw = size * size * sizeof(Map::Tile);
+    std::cout << "  " << data.size() << " bytes vs " << raw << " raw (x" << raw / data.size() << ")\n";
+}
+
+/**
+ *  автосохранение кодирует карту в главном потоке, в фон уходит только запись файла
+	замер показывает, сколько это от кадра: на картах игры (до 20x20) и на больших, которых в игре нет
+ */
+static void benchAutosave(size_t size, size_t bombs) {
+    Map map;
+    map.resize(size, Map::Layout::RowMajor);
+    map.generate(bombs, sf::Vector2u(size / 2, size / 2), 5);
+    map._OpenTiles(size / 2, size / 2);
+
+    save::Progress progress;
+    std::vector<uint8_t> data;
+    size_t reps = size <= 64 ? 100000 : 10;
+    std::string name = std::to_string(size) + "x" + std::to_string(size);
+
+    auto begin = std::chrono::steady_clock::now();
+    measure("save::encode " + name, reps, [&] { data.clear(); }, [&] {
+        save::encode(progress, map, data);
+    });
+    std::chrono::duration<double, std::milli> total = std::chrono::steady_clock::now() - begin;
+    std::cout << "  " << std::setprecision(3) << total.count() / reps / 16.667 * 100 << "% of a 60 fps frame\n";
+}
+
+/**
+ * восстановление партии из 10000 ходов без отрисовки
+ */
+static void benchReplay() {
+    replay::Replay log;
+    log.level = 2;
+    log.seed = 11;
+    log.first = sf::Vector2u(10, 10);
+
+    /**
+     * ходы без проигрыша: на бомбы ставятся и снимаются флаги, остальное открывается
+     */
+    Map map;
+    map.resize(log.level);
+    map.generate(difficulties[log.level].bombs, log.seed);
+    map.makeSafe(log.first, log.seed + 1);
+    Random rng(5);
+    log.events.push_back({0, replay::Action::Left, log.first.x, log.first.y});
+    for (uint32_t i = 1; i != 10000; i++) {
+        uint32_t x = rng.upTo(19), y = rng.upTo(19);
+        auto action = map._HasBomb(x, y) ? replay::Action::Right : replay::Action::Left;
+        log.events.push_back({i * 100, action, x, y});
+    }
+
+    Map played;
+    measure("replay::play 10000 actions [Hard]", 1000, [] {}, [&] {
+        replay::play(log, played);
+    });
+}
+
+/**
+ *  первое нажатие: раньше генерация всей карты, теперь перенос бомб из-под курсора
+    и перенос одной бомбы, из которого строятся генераторы на цепях Маркова
+ */
+static void benchFirstClick(size_t size, size_t bombs) {
+    std::string name = std::to_string(size) + "x" + std::to_string(size);
+    sf::Vector2u center(size / 2, size / 2);
+
+    Map pristine, map;
+    pristine.resize(size, Map::Layout::RowMajor);
+    map.resize(size, Map::Layout::RowMajor);
+    pristine.generate(bombs, 7);
+
+    /**
+     * бомба ставится прямо в точку нажатия, чтобы makeSafe было что переносить
+     */
+    size_t at = center.x + center.y * size;
+    if (!pristine._HasBomb(center.x, center.y))
+        pristine.moveMine(0, at);
+
+    measure("generate on first click " + name, 5, [] {}, [&] {
+        map.generate(bombs, center, 7);
+    });
+    measure("makeSafe (opening) " + name, 5, [&] { map = pristine; }, [&] {
+        map.makeSafe(center, 8, true);
+    });
+
+    Random rng(3);
+    measure("moveMine x1000 " + name, 5, [&] { map = pristine; }, [&] {
+        for (size_t i = 0; i != 1000; i++) {
+            size_t to = rng.upTo(size * size - 1);
+            if (!map._HasBomb(to % size, to / size))
+                map.moveMine(rng.upTo(bombs - 1), to);
+        }
+    });
+}
+
+/**
+ * многопоточная генерация одной большой карты, от одного потока до всех ядер
+ */
+static void benchParallelGenerate(size_t size) {
+    Map map;
+    map.resize(size, Map::Layout::RowMajor);
+    size_t bombs = size * size / 5;
+    std::string name = std::to_string(size) + "x" + std::to_string(size);
+
+    measure("generate (serial) " + name, 3, [] {}, [&] {
+        map.generate(bombs, 9);
+    });
+
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 1; threads <= std::min<size_t>(cores, 32); threads *= 2) {
+        alone::JobSystem jobs(threads - 1);
+        measure("generate (" + std::to_string(threads) + " threads) " + name, 3, [] {}, [&] {
+            map.generate(bombs, 9, jobs);
+        });
+    }
+}
+
+/**
+ *  накладные расходы пула: tasks пустых задач, на одну задачу - время, делённое на tasks
+	с нулём потоков это цена вызова std::function, с потоками - очереди, кража и ожидание
+ */
+static void benchJobs(size_t tasks) {
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t workers: std::set<size_t>{0, cores - 1, cores}) {
+        alone::JobSystem jobs(workers);
+        std::string name = " x" + std::to_string(tasks) + " (" + std::to_string(workers) + " workers)";
+
+        measure("task group" + name, 3, [] {}, [&] {
+            alone::TaskGroup group(jobs);
+            for (size_t i = 0; i != tasks; i++)
+                group.run([] {
+                    guard = guard + 1;
+                });
+            group.wait();
+        });
+        measure("parallel for, grain 1" + name, 3, [] {}, [&] {
+            jobs.parallelFor(0, tasks, 1, [](size_t from, size_t to) {
+                guard = guard + to - from;
+            });
+        });
+    }
+}
+
+/**
+ *  пирамида для карты издалека: постройка с нуля и догонка после большой заливки
+	догонка должна стоить от числа изменений, а не от размера карты
+ */
+static void benchLod(size_t size) {
+    std::string name = std::to_string(size) + "x" + std::to_string(size);
+    sf::Vector2u center(size / 2, size / 2);
+
+    Map pristine, map;
+    pristine.resize(size, Map::Layout::Tiled);
+    pristine.generate(size * size / 10, 5);
+    pristine.makeSafe(center, 6, true);
+    pristine.clearDirty();
+
+    LodPyramid lod;
+    measure("LodPyramid::build " + name, 3, [] {}, [&] {
+        lod.build(pristine);
+    });
+
+    map = pristine;
+    map.reveal(center.x, center.y);
+    std::cout << "  flood changed " << map.dirty().size() << " tiles\n";
+    measure("LodPyramid::update (flood) " + name, 3, [&] { lod.build(pristine); }, [&] {
+        lod.update(map, map.dirty());
+    });
+
+    std::vector<size_t> one = {center.x + 1 + center.y * size};
+    measure("LodPyramid::update (1 tile) " + name, 3, [&] { lod.build(pristine); }, [&] {
+        lod.update(map, one);
+    });
+}
+
+/**
+ *  время одного вызова для таблицы масштабирования
+    первый вызов не считается, в нём выделяется память
+    маленькие карты повторяются, пока не наберётся хотя бы 20 мс, иначе меряется шум таймера
+ */
+static double timeOf(const std::function<void()> &prepare, const std::function<void()> &body) {
+    prepare();
+    body();
+
+    std::chrono::duration<double> total(0);
+    size_t reps = 0;
+    while (total.count() < 0.02 && reps < 100000) {
+        prepare();
+        auto begin = std::chrono::steady_clock::now();
+        body();
+        total += std::chrono::steady_clock::now() - begin;
+        reps++;
+    }
+    return total.count() / reps;
+}
+
+/**
+ * классы сложности, с которыми сравниваются замеры, по возрастанию
+ */
+struct complexity_t {
+    const char *name;
+    double (*f)(double);
+
+    /**
+     * примерный наклон в log-log на размерах из набора
+     */
+    double slope;
+};
+
+static const complexity_t classes[] = {
+        {"O(1)",       [](double) { return 1.0; },                        0},
+        {"O(log n)",   [](double n) { return std::log2(n); },             0.1},
+        {"O(n)",       [](double n) { return n; },                        1},
+        {"O(n log n)", [](double n) { return n * std::log2(n); },         1.1},
+        {"O(n^1.5)",   [](double n) { return n * std::sqrt(n); },         1.5},
+        {"O(n^2)",     [](double n) { return n * n; },                    2}
+};
+
+/**
+ *  насколько наклон может превышать ожидаемый, пока это не считается ошибкой
+    когда карта перестаёт влезать в кэш, линейные операции на замерах дают наклон до ~1.3
+ */
+constexpr double Tolerance = 0.4;
+
+/**
+ *  подбор класса: для каждого t = c * f(n) считается разброс log(t / f(n)), берётся наименьший
+ *  @param slope сюда пишется наклон прямой в log-log, то есть показатель степени
+ *  @return номер в classes
+ */
+static size_t fit(const std::vector<std::pair<double, double>> &points, double &slope) {
+    double sx = 0, sy = 0, sxx = 0, sxy = 0, k = points.size();
+    for (auto [n, t]: points) {
+        sx += std::log(n);
+        sy += std::log(t);
+        sxx += std::log(n) * std::log(n);
+        sxy += std::log(n) * std::log(t);
+    }
+    slope = (k * sxy - sx * sy) / (k * sxx - sx * sx);
+
+    size_t best = 0;
+    double bestSpread = INFINITY;
+    for (size_t c = 0; c != std::size(classes); c++) {
+        double mean = 0, spread = 0;
+        for (auto [n, t]: points)
+            mean += std::log(t / classes[c].f(n)) / k;
+        for (auto [n, t]: points)
+            spread += std::pow(std::log(t / classes[c].f(n)) - mean, 2);
+        if (spread < bestSpread) {
+            bestSpread = spread;
+            best = c;
+        }
+    }
+    return best;
+}
+
+/**
+ *  набор полных партий без окна на картах от 8x8 до max x max и плотностях от 5% до 40%
+    по замерам подбирается класс сложности каждой операции
+    если он хуже ожидаемого, то строка помечается, так квадратичная генерация через std::set была бы видна сразу
+ */
+static void benchScaling(size_t max) {
+    struct operation_t {
+        const char *name;
+
+        /**
+         * ожидаемый класс, номер в classes
+         */
+        size_t expected;
+
+        /**
+         * до какого размера мерить, вершины на огромных картах не помещаются в память
+         */
+        size_t limit;
+    };
+    /**
+     * codec сортирует бомбы, поэтому для него ожидается O(n log n)
+     */
+    const operation_t operations[] = {
+            {"generate",             2, SIZE_MAX},
+            {"play to completion",   2, SIZE_MAX},
+            {"buildMesh",            2, 2048},
+            {"codec::encode",        3, SIZE_MAX}
+    };
+    const double densities[] = {0.05, 0.10, 0.20, 0.40};
+
+    /**
+     * (операция, плотность) -> точки (клеток, секунд)
+     */
+    std::map<std::pair<size_t, double>, std::vector<std::pair<double, double>>> results;
+
+    std::cout << std::left << std::setw(12) << "size" << std::setw(10) << "density";
+    for (auto &op: operations)
+        std::cout << std::right << std::setw(20) << op.name;
+    std::cout << '\n';
+
+    Map map;
+    sf::VertexArray region(sf::Quads);
+    std::vector<uint8_t> data;
+    for (size_t size = 8; size <= max; size *= 2) {
+        map.resize(size, Map::Layout::RowMajor);
+        double cells = size * size;
+
+        for (double density: densities) {
+            size_t bombs = std::max<size_t>(1, density * cells);
+            std::cout << std::left << std::setw(12) << (std::to_string(size) + "x" + std::to_string(size))
+                      << std::setw(10) << (std::to_string((int) (density * 100)) + '%');
+
+            /**
+             *  партия играется до конца: первый клик с гарантированной областью
+	            дальше бот, который знает карту, ставит флаги на бомбы и открывает остальное по порядку
+             */
+            double times[std::size(operations)] = {
+                    timeOf([] {}, [&] {
+                        map.generate(bombs, 5);
+                    }),
+                    timeOf([&] {
+                        map.generate(bombs, 5);
+                    }, [&] {
+                        map.makeSafe(sf::Vector2u(size / 2, size / 2), 6, true);
+                        map.reveal(size / 2, size / 2);
+                        for (size_t y = 0; y != size && map.hiddenSafe() != 0; y++)
+                            for (size_t x = 0; x != size; x++)
+                                if (map._HasBomb(x, y))
+                                    map.toggleFlag(x, y);
+                                else
+                                    map.reveal(x, y);
+                        guard = map.hiddenSafe();
+                    }),
+                    size <= operations[2].limit ? timeOf([] {}, [&] {
+                        buildMesh(map, region, 100);
+                    }) : 0,
+                    timeOf([&] { data.clear(); }, [&] {
+                        codec::encode(map, data);
+                    })
+            };
+
+            for (size_t i = 0; i != std::size(operations); i++) {
+                std::cout << std::right << std::setw(17) << std::fixed << std::setprecision(1) << times[i] * 1e6 << " us";
+
+                /**
+                 * совсем маленькие карты в подбор не идут, там всё съедают накладные расходы
+                 */
+                if (times[i] > 0 && size >= 64)
+                    results[{i, density}].emplace_back(cells, times[i]);
+            }
+            std::cout << '\n';
+        }
+        region.clear();
+    }
+
+    std::cout << "\ncomplexity fit (n = tiles)\n";
+    for (auto &[key, points]: results) {
+        if (points.size() < 3)
+            continue;
+
+        double slope;
+        size_t found = fit(points, slope);
+        auto &op = operations[key.first];
+        bool worse = found > op.expected && slope > classes[op.expected].slope + Tolerance;
+
+        std::cout << std::left << std::setw(22) << op.name << std::setw(8) << (std::to_string((int) (key.second * 100)) + '%')
+                  << std::setw(12) << classes[found].name << "slope " << std::setprecision(2) << slope
+                  << (worse ? "   <-- WORSE THAN " : "") << (worse ? classes[op.expected].name : "") << '\n';
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+int main(int argc, char **argv) {
+    if (!counters.available())
+        std::cout << "hardware counters are not available, wall clock only\n\n";
+
+    /**
+     * bench --scaling [max_size] - только набор масштабирования
+     */
+    if (argc > 1 && std::strcmp(argv[1], "--scaling") == 0) {
+        benchScaling(argc > 2 ? std::stoul(argv[2]) : 8192);
+        return 0;
+    }
+
+    benchReplay();
+    std::cout << '\n';
+
+    benchCodec(20, 70);
+    benchCodec(2048, 2048 * 2048 / 100);
+    std::cout << '\n';
+
+    benchAutosave(20, 70);
+    benchAutosave(2048, 2048 * 2048 / 100);
+    std::cout << '\n';
+
+    benchFirstClick(20, 70);
+    benchFirstClick(2048, 2048 * 2048 / 5);
+    std::cout << '\n';
+
+    benchParallelGenerate(4096);
+    std::cout << '\n';
+
+    benchJobs(100000);
+    std::cout << '\n';
+
+    benchLod(8192);
+    std::cout << '\n';
+
+    benchFixed<EasyMap>("Easy", 200000);
+    benchFixed<HardMap>("Hard", 50000);
+    std::cout << '\n';
+
+
+    benchLayouts(256, 256 * 256 / 100);
+    benchLayouts(2048, 2048 * 2048 / 100);
+    return 0;
+}
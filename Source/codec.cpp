@@ -0,0 +1,130 @@
+#include "codec.h"
+
+#include <algorithm>
+
+void codec::putVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t) value | 0x80);
+        value >>= 7;
+    }
+    out.push_back((uint8_t) value);
+}
+
+bool codec::getVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (data == end)
+            return false;
+        uint8_t byte = *data++;
+        value |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * серии одного состояния отрисовки, state(i) - состояние клетки с индексом x + y * size
+ */
+template<class F>
+static void putRuns(std::vector<uint8_t> &out, size_t count, char wanted, F &&state) {
+    if (count == 0)
+        return;
+
+    bool inside = false;
+    size_t run = 0;
+    for (size_t i = 0; i != count; i++) {
+        if ((state(i) == wanted) != inside) {
+            codec::putVarint(out, run);
+            inside = !inside;
+            run = 0;
+        }
+        run++;
+    }
+    codec::putVarint(out, run);
+}
+
+void codec::encode(const Map &map, std::vector<uint8_t> &out) {
+    size_t size = map.size();
+    size_t count = size * size;
+
+    putVarint(out, size);
+
+    /**
+     * бомбы идут по возрастанию, тогда разницы маленькие и влезают в байт
+     * буфер свой у каждого потока, чтобы не выделять память на каждое сохранение
+     */
+    thread_local std::vector<size_t> mines;
+    mines.assign(map.mines().begin(), map.mines().end());
+    std::sort(mines.begin(), mines.end());
+
+    putVarint(out, mines.size());
+    size_t previous = 0;
+    for (size_t pos: mines) {
+        putVarint(out, pos - previous);
+        previous = pos + 1;
+    }
+
+    /**
+     * в построчной раскладке клетки уже лежат в нужном порядке
+     */
+    if (map.layout() == Map::Layout::RowMajor) {
+        auto state = [&](size_t i) {
+            return map._Content[i].first;
+        };
+        putRuns(out, count, 'r', state);
+        putRuns(out, count, 'f', state);
+    } else {
+        auto state = [&](size_t i) {
+            return map.at(i % size, i / size).first;
+        };
+        putRuns(out, count, 'r', state);
+        putRuns(out, count, 'f', state);
+    }
+}
+
+/**
+ * чтение серий и выставление состояния в клетки внутри них
+ */
+static bool getRuns(const uint8_t *&data, const uint8_t *end, Map &map, char state) {
+    size_t size = map.size();
+    size_t count = size * size;
+    bool inside = false;
+
+    for (size_t pos = 0; pos != count; inside = !inside) {
+        uint64_t run;
+        if (!codec::getVarint(data, end, run) || run > count - pos)
+            return false;
+        if (inside)
+            for (size_t i = pos; i != pos + run; i++)
+                map._SetState(i % size, i / size, state);
+        pos += run;
+    }
+    return true;
+}
+
+bool codec::decode(const uint8_t *&data, const uint8_t *end, Map &map) {
+    uint64_t size, bombs;
+    /**
+     * грань больше MaxSize - мусор, проверяется до resize, заодно size * size не переполнится
+     */
+    if (!getVarint(data, end, size) || size > MaxSize || !getVarint(data, end, bombs) || bombs > size * size)
+        return false;
+
+    if (map.size() != size)
+        map.resize(size, map.layout());
+
+    thread_local std::vector<size_t> mines;
+    mines.clear();
+    size_t previous = 0;
+    for (size_t i = 0; i != bombs; i++) {
+        uint64_t delta;
+        if (!getVarint(data, end, delta) || delta >= size * size - previous)
+            return false;
+        mines.push_back(previous + delta);
+        previous += delta + 1;
+    }
+    map.place(mines);
+
+    return getRuns(data, end, map, 'r') && getRuns(data, end, map, 'f');
+}
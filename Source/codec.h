@@ -0,0 +1,45 @@
+#pragma once
+//std
+#include <cstdint>
+#include <vector>
+
+#include "map.h"
+
+/**
+ *  компактная запись состояния карты для сохранений, повторов и передачи по сети
+    всё пишется varint'ами (по 7 бит в байте, старший бит - продолжение):
+        размер грани, количество бомб
+        бомбы по возрастанию индекса x + y * size, каждая как разница с предыдущей
+        открытые клетки - длины серий закрытых и открытых клеток по очереди, начиная с закрытых
+        флаги - так же
+ */
+namespace codec {
+
+    /**
+     *  самая большая грань, которую принимает decode, с запасом больше всех карт игры и бенчмарков (8192)
+	    иначе несколько байт мусора заставили бы выделить память под миллиарды клеток
+     */
+    constexpr uint64_t MaxSize = 1 << 14;
+
+    /**
+     * дописывает в out беззнаковое число
+     */
+    void putVarint(std::vector<uint8_t> &out, uint64_t value);
+
+    /**
+     * читает число, сдвигая data
+     * @return false, если данные кончились раньше числа
+     */
+    bool getVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value);
+
+    /**
+     * дописывает состояние карты в конец out
+     */
+    void encode(const Map &map, std::vector<uint8_t> &out);
+
+    /**
+     *  восстанавливает карту, раскладка карты сохраняется
+     *  @return false, если данные испорчены, карта тогда в неопределённом состоянии
+     */
+    bool decode(const uint8_t *&data, const uint8_t *end, Map &map);
+}
@@ -0,0 +1,37 @@
+#include "coroutine.h"
+
+#include <utility>
+
+alone::Coroutine::Coroutine(Coroutine &&other) noexcept : _Handle(std::exchange(other._Handle, nullptr)) {}
+
+alone::Coroutine &alone::Coroutine::operator=(Coroutine &&other) noexcept {
+    if (this != &other) {
+        if (_Handle)
+            _Handle.destroy();
+        _Handle = std::exchange(other._Handle, nullptr);
+    }
+    return *this;
+}
+
+alone::Coroutine::~Coroutine() {
+    if (_Handle)
+        _Handle.destroy();
+}
+
+bool alone::Coroutine::resume() {
+    if (!_Handle)
+        return true;
+
+    auto &promise = _Handle.promise();
+    if (!_Handle.done() && (!promise.ready || promise.ready())) {
+        promise.ready = nullptr;
+        _Handle.resume();
+    }
+
+    /**
+     * исключение могло случиться и до первого ожидания, тогда оно ждёт здесь первого resume
+     */
+    if (promise.error)
+        std::rethrow_exception(std::exchange(promise.error, nullptr));
+    return _Handle.done();
+}
@@ -0,0 +1,136 @@
+#pragma once
+//std
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <future>
+#include <type_traits>
+
+namespace alone {
+
+    /**
+     *  сопрограмма состояния: живёт в главном потоке, а ждать может следующего кадра или фоновой работы
+	    машина состояний зовёт resume раз в кадр, и сопрограмма идёт дальше, только когда то, чего она ждёт, готово
+	    поэтому её код всегда выполняется в главном потоке и может трогать окно, текстуры и само состояние
+	    до первого co_await она идёт сразу при вызове
+     */
+    class Coroutine {
+    public:
+        struct promise_type {
+            /**
+             * готово ли то, чего сейчас ждёт сопрограмма, пусто - продолжить при следующем resume
+             */
+            std::function<bool()> ready;
+            std::exception_ptr error;
+
+            Coroutine get_return_object() {
+                return Coroutine(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            std::suspend_never initial_suspend() noexcept {
+                return {};
+            }
+
+            std::suspend_always final_suspend() noexcept {
+                return {};
+            }
+
+            void return_void() {}
+
+            void unhandled_exception() {
+                error = std::current_exception();
+            }
+        };
+
+        using handle_t = std::coroutine_handle<promise_type>;
+
+        /**
+         * пустая сопрограмма, она сразу считается законченной
+         */
+        Coroutine() = default;
+
+        Coroutine(Coroutine &&other) noexcept;
+
+        Coroutine &operator=(Coroutine &&other) noexcept;
+
+        Coroutine(const Coroutine &) = delete;
+
+        Coroutine &operator=(const Coroutine &) = delete;
+
+        /**
+         * недоделанная сопрограмма уничтожается вместе со своим ожиданием, фоновая работа при этом дожидается
+         */
+        ~Coroutine();
+
+        bool done() const {
+            return !_Handle || _Handle.done();
+        }
+
+        /**
+         *  продолжает сопрограмму, если ожидание кончилось, исключение изнутри выбрасывается отсюда
+         *  @return true, если сопрограмма закончилась
+         */
+        bool resume();
+
+    private:
+        explicit Coroutine(handle_t handle) : _Handle(handle) {}
+
+        handle_t _Handle;
+    };
+
+    /**
+     * co_await alone::nextFrame() - продолжить в следующем кадре
+     */
+    struct NextFrame {
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(Coroutine::handle_t handle) const {
+            handle.promise().ready = nullptr;
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    inline NextFrame nextFrame() {
+        return {};
+    }
+
+    /**
+     *  ожидание фоновой работы, co_await возвращает её результат
+	    готовность проверяется раз в кадр без блокировки, так что кадры идут, пока работа не кончится
+     */
+    template<class T>
+    class Background {
+    public:
+        explicit Background(std::future<T> future) : _Future(std::move(future)) {}
+
+        bool await_ready() const {
+            return _Future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }
+
+        void await_suspend(Coroutine::handle_t handle) {
+            handle.promise().ready = [this] {
+                return await_ready();
+            };
+        }
+
+        T await_resume() {
+            return _Future.get();
+        }
+
+    private:
+        std::future<T> _Future;
+    };
+
+    /**
+     *  запускает fn в отдельном потоке, как автосохранение, и даёт его дождаться через co_await
+	    пока сопрограмма ждёт, fn может работать с тем, что главный поток в это время не трогает
+     */
+    template<class F>
+    Background<std::invoke_result_t<F>> background(F fn) {
+        return Background<std::invoke_result_t<F>>(std::async(std::launch::async, std::move(fn)));
+    }
+}
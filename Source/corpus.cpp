@@ -0,0 +1,238 @@
+#include "corpus.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+size_t corpus::maskSize(const Header &header) {
+    return ((size_t) header.size * header.size + 7) / 8;
+}
+
+size_t corpus::recordSize(const Header &header) {
+    size_t size = maskSize(header);
+    if (header.flags & FirstClick)
+        size += 2 * sizeof(uint32_t);
+    if (header.flags & Seed)
+        size += sizeof(uint64_t);
+    return size;
+}
+
+uint64_t corpus::recordOffset(const Header &header, uint64_t index) {
+    return sizeof(Header) + header.count * sizeof(uint64_t) + index * recordSize(header);
+}
+
+bool corpus::create(const std::string &path, const Header &header) {
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+        file.write((const char *) &header, sizeof(header));
+
+        /**
+         * индекс пишется кусками, чтобы не держать в памяти весь
+         */
+        std::vector<uint64_t> index;
+        for (uint64_t i = 0; i < header.count; i += 1 << 16) {
+            index.clear();
+            for (uint64_t k = i; k != std::min<uint64_t>(header.count, i + (1 << 16)); k++)
+                index.push_back(recordOffset(header, k));
+            file.write((const char *) index.data(), index.size() * sizeof(uint64_t));
+        }
+
+        /**
+         * ошибка записи буфера вылезет только при закрытии
+         */
+        file.close();
+        if (!file)
+            return false;
+    }
+
+    std::error_code error;
+    std::filesystem::resize_file(path, recordOffset(header, header.count), error);
+    return !error;
+}
+
+void corpus::encode(const Header &header, const Map &map, sf::Vector2u first, uint64_t seed, uint8_t *out) {
+    if (header.flags & FirstClick) {
+        uint32_t point[2] = {first.x, first.y};
+        std::memcpy(out, point, sizeof(point));
+        out += sizeof(point);
+    }
+    if (header.flags & Seed) {
+        std::memcpy(out, &seed, sizeof(seed));
+        out += sizeof(seed);
+    }
+
+    /**
+     * маска бомб
+     */
+    std::memset(out, 0, maskSize(header));
+    size_t bit = 0;
+    for (size_t y = 0; y != header.size; y++)
+        for (size_t x = 0; x != header.size; x++, bit++)
+            if (map.at(x, y).second == Type::Bomb)
+                out[bit / 8] |= 1 << (bit % 8);
+}
+
+sf::Vector2u corpus::generate(Map &map, const Header &header, uint64_t index, uint64_t &seed) {
+    Random rng(header.seed + index);
+    uint64_t first = rng();
+    seed = rng();
+
+    sf::Vector2u point(first % header.size, (first >> 32) % header.size);
+    if (map.size() != header.size)
+        map.resize(header.size, Map::Layout::RowMajor);
+    map.generate(header.bombs, point, seed);
+    return point;
+}
+
+sf::Vector2u corpus::BoardView::firstClick() const {
+    if (!(_Header->flags & FirstClick))
+        return {};
+    uint32_t point[2];
+    std::memcpy(point, _Record, sizeof(point));
+    return {point[0], point[1]};
+}
+
+uint64_t corpus::BoardView::seed() const {
+    if (!(_Header->flags & Seed))
+        return 0;
+    uint64_t seed;
+    std::memcpy(&seed, _Record + (_Header->flags & FirstClick ? 2 * sizeof(uint32_t) : 0), sizeof(seed));
+    return seed;
+}
+
+bool corpus::BoardView::load(Map &map) const {
+
+    /**
+     *  пустые байты маски пропускаем целиком
+	    лишние биты последнего байта должны быть нулями, иначе place писал бы за край поля
+     */
+    std::vector<size_t> mines;
+    const uint8_t *bits = mask();
+    size_t cells = size() * size();
+    for (size_t i = 0; i != maskSize(*_Header); i++)
+        for (uint8_t byte = bits[i]; byte; byte &= byte - 1) {
+            size_t pos = i * 8 + std::countr_zero(byte);
+            if (pos >= cells)
+                return false;
+            mines.push_back(pos);
+        }
+
+    if (map.size() != size())
+        map.resize(size(), map.layout());
+    map.place(mines);
+    return true;
+}
+
+corpus::File::~File() {
+    close();
+}
+
+bool corpus::File::open(const std::string &path) {
+    close();
+
+#ifdef _WIN32
+    _File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (_File == INVALID_HANDLE_VALUE) {
+        _File = nullptr;
+        return false;
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(_File, &size);
+    _Size = size.QuadPart;
+    _Mapping = CreateFileMappingA(_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_Mapping)
+        _Data = (const uint8_t *) MapViewOfFile(_Mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        _Size = info.st_size;
+        void *data = mmap(nullptr, _Size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED)
+            _Data = (const uint8_t *) data;
+    }
+    /**
+     * отображение держит файл само, дескриптор больше не нужен
+     */
+    ::close(fd);
+#endif
+
+    /**
+     * проверка, что это действительно набор карт и что он не обрезан
+     */
+    if (!_Data || _Size < sizeof(Header) || std::memcmp(header().magic, Header().magic, 4) != 0 ||
+        header().version != Version) {
+        close();
+        return false;
+    }
+
+    /**
+     * количество сверяется с размером файла делением, произведение у испорченного заголовка переполнилось бы
+     */
+    size_t record = recordSize(header());
+    if (header().count > (_Size - sizeof(Header)) / (sizeof(uint64_t) + record)) {
+        close();
+        return false;
+    }
+
+    /**
+     *  записи индекса тут не читаются: на сотнях миллионов карт это гигабайты страниц до первой карты
+	    их проверяет at, одним сравнением с _Last
+     */
+    _Index = (const uint64_t *) (_Data + sizeof(Header));
+    _Last = _Size - record;
+    return true;
+}
+
+void corpus::File::close() {
+#ifdef _WIN32
+    if (_Data)
+        UnmapViewOfFile(_Data);
+    if (_Mapping)
+        CloseHandle(_Mapping);
+    if (_File)
+        CloseHandle(_File);
+    _Mapping = _File = nullptr;
+#else
+    if (_Data)
+        munmap((void *) _Data, _Size);
+#endif
+    _Data = nullptr;
+    _Index = nullptr;
+    _Size = _Last = 0;
+}
+
+void corpus::File::prefetch(size_t first, size_t count) const {
+    if (!_Data || first >= this->count())
+        return;
+    count = std::min(count, this->count() - first);
+    if (count == 0)
+        return;
+#ifndef _WIN32
+    /**
+     * адрес для madvise должен быть выровнен по странице
+     */
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t begin = std::min<size_t>(_Index[first], _Last) / page * page;
+    size_t end = std::min<size_t>(_Index[first + count - 1], _Last) + recordSize(header());
+    if (end <= begin)
+        return;
+    madvise((void *) (_Data + begin), end - begin, MADV_WILLNEED);
+#endif
+}
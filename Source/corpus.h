@@ -0,0 +1,203 @@
+#pragma once
+//std
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "map.h"
+
+/**
+ *  двоичный набор карт
+    в начале файла заголовок фиксированного размера, за ним индекс - смещения всех записей от начала файла (uint64)
+    потом сами записи
+    запись - это (по флагам) точка первого нажатия, зерно генератора и битовая маска бомб
+    бит клетки (x, y) имеет номер x + y * size, младший бит байта идёт первым
+    файл читается через mmap, поэтому все поля лежат так, как их надо читать, без разбора
+ */
+namespace corpus {
+
+    /**
+     * текущая версия формата, 1 была без индекса
+     */
+    constexpr uint16_t Version = 2;
+
+    /**
+     * флаги того, что лежит в каждой записи кроме маски
+     */
+    enum Flags : uint16_t {
+        FirstClick = 1,
+        Seed = 2
+    };
+
+    /**
+     * заголовок файла, пишется как есть, little endian
+     */
+#pragma pack(push, 1)
+    struct Header {
+        char magic[4] = {'S', 'A', 'P', 'R'};
+        uint16_t version = Version;
+        uint16_t flags = 0;
+        uint32_t size = 0;
+        uint32_t bombs = 0;
+        uint64_t count = 0;
+        uint64_t seed = 0;
+    };
+#pragma pack(pop)
+
+    /**
+     * размер битовой маски одной карты в байтах
+     */
+    size_t maskSize(const Header &header);
+
+    /**
+     * размер одной записи в байтах
+     */
+    size_t recordSize(const Header &header);
+
+    /**
+     * смещение записи от начала файла, записи лежат подряд сразу за индексом
+     */
+    uint64_t recordOffset(const Header &header, uint64_t index);
+
+    /**
+     *  создаёт файл с заголовком и индексом и сразу выделяет место под все записи
+	    дальше записи можно писать в любом порядке и из любого количества потоков
+     */
+    bool create(const std::string &path, const Header &header);
+
+    /**
+     *  запись одной карты в out, там должно быть recordSize(header) байт
+     *  @param first точка первого нажатия, пишется только с флагом FirstClick
+     */
+    void encode(const Header &header, const Map &map, sf::Vector2u first, uint64_t seed, uint8_t *out);
+
+    /**
+     *  генерация карты номер index так же, как это делает saper_gen
+	    из seed + index получаются точка первого нажатия и зерно для Map::generate
+     *  @param seed сюда пишется зерно, с которым вызывался Map::generate
+     */
+    sf::Vector2u generate(Map &map, const Header &header, uint64_t index, uint64_t &seed);
+
+    /**
+     *  карта из набора, ничего не копирует, а смотрит прямо в отображённый файл
+	    живёт не дольше File, из которого получена
+     */
+    class BoardView {
+    public:
+        BoardView(const Header *header, const uint8_t *record) : _Header(header), _Record(record) {}
+
+        size_t size() const {
+            return _Header->size;
+        }
+
+        size_t bombs() const {
+            return _Header->bombs;
+        }
+
+        /**
+         * точка первого нажатия, если её нет в наборе, то (0, 0)
+         */
+        sf::Vector2u firstClick() const;
+
+        /**
+         * зерно, с которым генерировалась карта, если его нет в наборе, то 0
+         */
+        uint64_t seed() const;
+
+        /**
+         * битовая маска бомб
+         */
+        const uint8_t *mask() const {
+            return _Record + recordSize(*_Header) - maskSize(*_Header);
+        }
+
+        bool _HasBomb(size_t x, size_t y) const {
+            if (x >= size() || y >= size())
+                return false;
+            size_t bit = x + y * size();
+            return mask()[bit / 8] >> (bit % 8) & 1;
+        }
+
+        /**
+         *  расставляет бомбы и числа из набора на карту
+         *  @return false, если в маске стоят биты за краем поля (файл испорчен), карта тогда не меняется
+         */
+        bool load(Map &map) const;
+
+    private:
+        const Header *_Header;
+        const uint8_t *_Record;
+    };
+
+    /**
+     *  набор карт, отображённый в память
+	    открытие не читает файл, страницы подгружает система по мере обращения
+     */
+    class File {
+    public:
+        File() = default;
+
+        File(const File &) = delete;
+
+        File &operator=(const File &) = delete;
+
+        ~File();
+
+        /**
+         *  проверяются только заголовок и то, что индекс и записи помещаются в файл, за O(1)
+	        сами записи индекса не читаются, их проверяет at при обращении
+         *  @return false, если файла нет или это не набор карт нужной версии
+         */
+        bool open(const std::string &path);
+
+        void close();
+
+        const Header &header() const {
+            return *(const Header *) _Data;
+        }
+
+        size_t count() const {
+            return _Data ? header().count : 0;
+        }
+
+        /**
+         * карта по номеру за O(1) через индекс, без проверок, для файлов, которые сгенерированы у себя
+         */
+        BoardView operator[](size_t index) const {
+            assert(index < count() && _Index[index] <= _Last);
+            return BoardView(&header(), _Data + _Index[index]);
+        }
+
+        /**
+         *  то же с проверкой номера и записи индекса: запись должна целиком лежать в файле
+         *  @return пусто, если номер за концом или файл испорчен
+         */
+        std::optional<BoardView> at(size_t index) const {
+            if (index >= count() || _Index[index] > _Last)
+                return std::nullopt;
+            return BoardView(&header(), _Data + _Index[index]);
+        }
+
+        /**
+         * подсказка системе заранее подгрузить записи [first, first + count)
+         */
+        void prefetch(size_t first, size_t count) const;
+
+    private:
+        const uint8_t *_Data = nullptr;
+        const uint64_t *_Index = nullptr;
+        size_t _Size = 0;
+
+        /**
+         * последнее смещение, с которого запись ещё помещается в файл
+         */
+        size_t _Last = 0;
+
+#ifdef _WIN32
+        void *_File = nullptr;
+        void *_Mapping = nullptr;
+#endif
+    };
+}
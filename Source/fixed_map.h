@@ -0,0 +1,247 @@
+#pragma once
+//std
+#include <array>
+
+#include "map.h"
+
+/**
+ *  карта с размером и количеством бомб, известными на этапе компиляции
+    используется для встроенных уровней сложности в ботах и симуляциях, где играются миллионы партий
+    вся память лежит внутри объекта, кучу не трогает
+    по краям карты лежит рамка из открытых пустых клеток, поэтому соседей можно смотреть без проверки границ
+ */
+template<size_t Size, size_t Mines>
+class FixedMap {
+public:
+    static_assert(Mines < Size * Size, "first click must stay free");
+
+    using Tile = Map::Tile;
+
+    /**
+     * ширина строки вместе с рамкой
+     */
+    static constexpr size_t Stride = Size + 2;
+
+    /**
+     * смещения до 8 соседей в массиве с рамкой
+     */
+    static constexpr std::array<ptrdiff_t, 8> Around = {
+            -(ptrdiff_t) Stride - 1, -(ptrdiff_t) Stride, -(ptrdiff_t) Stride + 1,
+            -1, 1,
+            (ptrdiff_t) Stride - 1, (ptrdiff_t) Stride, (ptrdiff_t) Stride + 1
+    };
+
+    FixedMap() {
+        _Clear();
+    }
+
+    /**
+     * размер грани карты
+     */
+    static constexpr size_t size() {
+        return Size;
+    }
+
+    /**
+     * кол-во бомб по умолчанию
+     */
+    static constexpr size_t mines() {
+        return Mines;
+    }
+
+    const Tile &at(size_t x, size_t y) const {
+        return _Content[_Index(x, y)];
+    }
+
+    void _SetState(size_t x, size_t y, char state) {
+        auto &tile = _Content[_Index(x, y)];
+        _Account(tile, -1);
+        tile.first = state;
+        _Account(tile, 1);
+    }
+
+    void _SetType(size_t x, size_t y, Type type) {
+        auto &tile = _Content[_Index(x, y)];
+        _Account(tile, -1);
+        tile.second = type;
+        _Account(tile, 1);
+    }
+
+    /**
+     * счётчики конца игры, те же, что у Map
+     */
+    size_t hiddenSafe() const {
+        return _HiddenSafe;
+    }
+
+    size_t correctFlags() const {
+        return _CorrectFlags;
+    }
+
+    size_t wrongFlags() const {
+        return _WrongFlags;
+    }
+
+    size_t exploded() const {
+        return _Exploded;
+    }
+
+    /**
+     * проверяет, есть ли бомба по заданному индексу
+     * @return если выходит индекс за пределы карты, то возвращает false
+     */
+    bool _HasBomb(size_t x, size_t y) const {
+        if (x >= Size || y >= Size)
+            return false;
+        return at(x, y).second == Type::Bomb;
+    }
+
+    /**
+     * проверяет все клетки вокруг, цикл по constexpr таблице компилятор разворачивает
+     */
+    size_t _DetectAround(size_t x, size_t y) const {
+        return _CountAround(_Index(x, y));
+    }
+
+    /**
+     * генерация карты с количеством бомб по умолчанию
+     */
+    void generate(sf::Vector2u point, uint64_t seed) {
+        generate(Mines, point, seed);
+    }
+
+    /**
+     *  генерация с заданным количеством бомб
+	    бомбы ставятся так же, как в Map::generate, поэтому при одном зерне карты совпадают
+     */
+    void generate(size_t bombs, sf::Vector2u point, uint64_t seed) {
+        _Clear();
+
+        Random rng(seed);
+
+        size_t cells = Size * Size - 1;
+        size_t skip = point.x + point.y * Size;
+
+        for (size_t j = cells - bombs; j != cells; j++) {
+            size_t pos = rng.upTo(j);
+            pos += pos >= skip;
+
+            if (_HasBomb(pos % Size, pos / Size))
+                pos = j + (j >= skip);
+
+            _SetType(pos % Size, pos / Size, Type::Bomb);
+            _Placed[j - (cells - bombs)] = _Index(pos % Size, pos / Size);
+        }
+
+        /**
+         * каждая бомба прибавляет единицу соседям, рамку пропускаем, она открыта
+         */
+        for (size_t k = 0; k != bombs; k++) {
+            for (auto offset: Around) {
+                auto &tile = _Content[_Placed[k] + offset];
+                if (tile.second == Type::Bomb || tile.first == 'r')
+                    continue;
+                tile.second = tile.second == Type::None ? Type::Number1 : (Type) ((size_t) tile.second + 1);
+            }
+        }
+    }
+
+    /**
+     *  открывает тайлы вокруг нажатого
+	    каждая клетка попадает в стек не больше одного раза, поэтому хватает массива на Size * Size
+     */
+    void _OpenTiles(int x, int y) {
+        if (x < 0 || y < 0 || x >= (int) Size || y >= (int) Size)
+            return;
+
+        size_t top = 0;
+        size_t start = _Index(x, y);
+        if (_Content[start].first != 'n')
+            return;
+
+        bool empty = _Content[start].second == Type::None;
+        _SetState(x, y, 'r');
+        if (!empty)
+            return;
+
+        _Stack[top++] = start;
+        while (top != 0) {
+            size_t i = _Stack[--top];
+
+            for (auto offset: Around) {
+                auto &tile = _Content[i + offset];
+
+                /**
+                 * рамка всегда открыта, так что за край карты обход не уйдёт, флаги обход не трогает
+                 */
+                if (tile.first != 'n')
+                    continue;
+
+                /**
+                 * соседи пустой клетки бомбами быть не могут
+                 */
+                tile.first = 'r';
+                _HiddenSafe--;
+                if (tile.second == Type::None)
+                    _Stack[top++] = i + offset;
+            }
+        }
+    }
+
+private:
+
+    static constexpr size_t _Index(size_t x, size_t y) {
+        return (y + 1) * Stride + x + 1;
+    }
+
+    void _Account(const Tile &tile, int sign) {
+        bool bomb = tile.second == Type::Bomb;
+        _HiddenSafe += sign * (tile.first != 'r' && !bomb);
+        _CorrectFlags += sign * (tile.first == 'f' && bomb);
+        _WrongFlags += sign * (tile.first == 'f' && !bomb);
+        _Exploded += sign * (tile.first == 'r' && bomb);
+    }
+
+    size_t _CountAround(size_t index) const {
+        size_t value = 0;
+        for (auto offset: Around)
+            value += _Content[index + offset].second == Type::Bomb;
+        return value;
+    }
+
+    /**
+     * всё поле закрыто и пусто, рамка открыта
+     */
+    void _Clear() {
+        _Content.fill({'r', Type::None});
+        for (size_t y = 0; y != Size; y++)
+            for (size_t x = 0; x != Size; x++)
+                _Content[_Index(x, y)] = {'n', Type::None};
+        _HiddenSafe = Size * Size;
+        _CorrectFlags = _WrongFlags = _Exploded = 0;
+    }
+
+    std::array<Tile, Stride * Stride> _Content;
+
+    size_t _HiddenSafe = 0;
+    size_t _CorrectFlags = 0;
+    size_t _WrongFlags = 0;
+    size_t _Exploded = 0;
+
+    std::array<uint32_t, Size * Size> _Stack;
+
+    /**
+     * индексы бомб с последней генерации
+     */
+    std::array<uint32_t, Size * Size> _Placed;
+};
+
+/**
+ * встроенные уровни сложности, совпадают с difficulties
+ */
+using EasyMap = FixedMap<8, 10>;
+using MediumMap = FixedMap<10, 20>;
+using HardMap = FixedMap<20, 70>;
+
+static_assert(Board<EasyMap>);
+static_assert(Board<HardMap>);
@@ -0,0 +1,160 @@
+#include "jobs.h"
+
+/**
+ * номер очереди текущего потока в его пуле, у посторонних потоков - nullptr
+ */
+static thread_local const alone::JobSystem *currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+alone::JobSystem::JobSystem(size_t workers) {
+    for (size_t i = 0; i != workers; i++)
+        _Workers.push_back(std::make_unique<worker_t>());
+    for (size_t i = 0; i != workers; i++)
+        _Workers[i]->thread = std::thread(&JobSystem::_Run, this, i);
+}
+
+alone::JobSystem::~JobSystem() {
+    {
+        std::lock_guard lock(_Mutex);
+        _Stop = true;
+    }
+    _Wake.notify_all();
+    for (auto &it: _Workers)
+        it->thread.join();
+}
+
+alone::JobSystem &alone::JobSystem::shared() {
+    static JobSystem jobs(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return jobs;
+}
+
+void alone::JobSystem::_Push(task_t task) {
+    /**
+     * свои задачи поток кладёт к себе, остальные раздаются по кругу
+     */
+    size_t index = currentPool == this ? currentWorker : _Next++ % _Workers.size();
+    {
+        auto &worker = *_Workers[index];
+        std::lock_guard lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+
+    /**
+     * счётчик меняется под общим мьютексом, иначе спящий поток может пропустить сигнал
+     */
+    {
+        std::lock_guard lock(_Mutex);
+        _Queued++;
+    }
+    _Wake.notify_one();
+}
+
+bool alone::JobSystem::_Take(size_t self, task_t &out) {
+    if (_Queued == 0)
+        return false;
+
+    if (self != _Workers.size()) {
+        auto &worker = *_Workers[self];
+        std::lock_guard lock(worker.mutex);
+        if (!worker.tasks.empty()) {
+            out = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+            _Queued--;
+            return true;
+        }
+    }
+
+    /**
+     * кража с начала чужой очереди, там лежат самые старые и обычно самые крупные задачи
+     */
+    for (size_t k = 1; k <= _Workers.size(); k++) {
+        auto &victim = *_Workers[(self + k) % _Workers.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            out = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            _Queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void alone::JobSystem::_Execute(task_t &task) {
+    if (!task.group->cancelled())
+        task.fn();
+    task.group->_Pending--;
+}
+
+void alone::JobSystem::_Run(size_t self) {
+    currentPool = this;
+    currentWorker = self;
+
+    task_t task;
+    while (true) {
+        if (_Take(self, task)) {
+            _Execute(task);
+            continue;
+        }
+
+        std::unique_lock lock(_Mutex);
+        _Wake.wait(lock, [this] {
+            return _Stop || _Queued != 0;
+        });
+        if (_Stop)
+            return;
+    }
+}
+
+void alone::JobSystem::parallelFor(size_t begin, size_t end, size_t grain,
+                                   const std::function<void(size_t, size_t)> &body) {
+    grain = std::max<size_t>(1, grain);
+
+    /**
+     * без потоков просто цикл по кускам, в том же порядке
+     */
+    if (_Workers.empty()) {
+        for (size_t from = begin; from < end; from += grain)
+            body(from, std::min(end, from + grain));
+        return;
+    }
+
+    TaskGroup group(*this);
+    for (size_t from = begin; from < end; from += grain) {
+        size_t to = std::min(end, from + grain);
+        group.run([&body, from, to] {
+            body(from, to);
+        });
+    }
+    group.wait();
+}
+
+alone::TaskGroup::~TaskGroup() {
+    wait();
+}
+
+void alone::TaskGroup::run(std::function<void()> task) {
+    if (_Jobs._Workers.empty()) {
+        if (!_Cancelled)
+            task();
+        return;
+    }
+
+    _Pending++;
+    _Jobs._Push({std::move(task), this});
+}
+
+void alone::TaskGroup::wait() {
+    size_t self = currentPool == &_Jobs ? currentWorker : _Jobs._Workers.size();
+
+    JobSystem::task_t task;
+    while (_Pending != 0) {
+        /**
+         * пока ждём, помогаем: выполняем любые задачи пула, не только свои
+         */
+        if (_Jobs._Take(self, task))
+            _Jobs._Execute(task);
+        else
+            std::this_thread::yield();
+    }
+}
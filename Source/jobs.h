@@ -0,0 +1,133 @@
+#pragma once
+//std
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace alone {
+    class TaskGroup;
+
+    /**
+     *  пул потоков с кражей работы
+	    у каждого потока своя очередь: свои задачи он берёт с конца, чужие крадёт с начала
+	    задачи из посторонних потоков (главного, например) раздаются по очередям по кругу
+	    с нулём рабочих потоков всё выполняется прямо в вызывающем потоке, по порядку, так что результат детерминирован
+     */
+    class JobSystem {
+        friend class TaskGroup;
+
+    public:
+        /**
+         * @param workers количество рабочих потоков, 0 - без потоков
+         */
+        explicit JobSystem(size_t workers);
+
+        JobSystem(const JobSystem &) = delete;
+
+        JobSystem &operator=(const JobSystem &) = delete;
+
+        ~JobSystem();
+
+        size_t workers() const {
+            return _Workers.size();
+        }
+
+        /**
+         *  вызывает body(from, to) для кусков [begin, end) по grain элементов и ждёт их все
+	        вызывающий поток тоже выполняет куски, пока ждёт
+         */
+        void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> &body);
+
+        /**
+         * общий пул на всю программу, потоков на один меньше, чем ядер, последнее ядро - вызывающий поток
+         */
+        static JobSystem &shared();
+
+    private:
+        struct task_t {
+            std::function<void()> fn;
+            TaskGroup *group;
+        };
+
+        /**
+         * очередь одного потока, мьютекс у каждой свой, так что потоки почти не мешают друг другу
+         */
+        struct worker_t {
+            std::mutex mutex;
+            std::deque<task_t> tasks;
+            std::thread thread;
+        };
+
+        void _Push(task_t task);
+
+        /**
+         *  берёт задачу: сначала из своей очереди с конца, потом крадёт из чужих с начала
+         *  @param self номер своей очереди или workers(), если вызывающий поток не из пула
+         */
+        bool _Take(size_t self, task_t &out);
+
+        void _Execute(task_t &task);
+
+        void _Run(size_t self);
+
+        std::vector<std::unique_ptr<worker_t>> _Workers;
+
+        /**
+         * сколько задач лежит во всех очередях, по нему спят и просыпаются потоки
+         */
+        std::atomic<size_t> _Queued = 0;
+        std::atomic<size_t> _Next = 0;
+        std::mutex _Mutex;
+        std::condition_variable _Wake;
+        bool _Stop = false;
+    };
+
+    /**
+     *  группа задач, которую можно дождаться или отменить
+	    отмена не прерывает уже идущие задачи, но ещё не начатые пропускаются
+     */
+    class TaskGroup {
+        friend class JobSystem;
+
+    public:
+        explicit TaskGroup(JobSystem &jobs) : _Jobs(jobs) {}
+
+        TaskGroup(const TaskGroup &) = delete;
+
+        TaskGroup &operator=(const TaskGroup &) = delete;
+
+        /**
+         * группа не может пережить свои задачи, поэтому деструктор ждёт
+         */
+        ~TaskGroup();
+
+        /**
+         * без рабочих потоков задача выполняется сразу
+         */
+        void run(std::function<void()> task);
+
+        /**
+         * ждёт все задачи группы, пока ждёт - сам выполняет задачи из пула
+         */
+        void wait();
+
+        void cancel() {
+            _Cancelled = true;
+        }
+
+        bool cancelled() const {
+            return _Cancelled;
+        }
+
+    private:
+        JobSystem &_Jobs;
+        std::atomic<size_t> _Pending = 0;
+        std::atomic<bool> _Cancelled = false;
+    };
+}
@@ -0,0 +1,104 @@
+#include "lod.h"
+
+#include <algorithm>
+
+size_t LodPyramid::_Tiles(size_t level, size_t x, size_t y) const {
+    size_t s = span(level);
+    return std::min(s, _Size - x * s) * std::min(s, _Size - y * s);
+}
+
+LodPyramid::cell_t LodPyramid::_Leaf(const Map &map, size_t x, size_t y) const {
+    size_t revealed = 0;
+    cell_t cell;
+    for (size_t j = y * 2; j != std::min(_Size, y * 2 + 2); j++)
+        for (size_t i = x * 2; i != std::min(_Size, x * 2 + 2); i++) {
+            auto &tile = map.at(i, j);
+            revealed += tile.first == 'r';
+            cell.flagged = cell.flagged || tile.first == 'f';
+            cell.exploded = cell.exploded || (tile.first == 'r' && tile.second == Type::Bomb);
+        }
+    cell.revealed = revealed * 255 / _Tiles(0, x, y);
+    return cell;
+}
+
+LodPyramid::cell_t LodPyramid::_Merge(size_t level, size_t x, size_t y) const {
+    size_t below = side(level - 1), weighted = 0;
+    cell_t cell;
+    for (size_t j = y * 2; j != std::min(below, y * 2 + 2); j++)
+        for (size_t i = x * 2; i != std::min(below, x * 2 + 2); i++) {
+            auto &child = at(level - 1, i, j);
+            weighted += child.revealed * _Tiles(level - 1, i, j);
+            cell.flagged = cell.flagged || child.flagged;
+            cell.exploded = cell.exploded || child.exploded;
+        }
+
+    /**
+     * с округлением, чтобы полностью открытый квадрат оставался 255, а не 254
+     */
+    size_t tiles = _Tiles(level, x, y);
+    cell.revealed = (weighted + tiles / 2) / tiles;
+    return cell;
+}
+
+void LodPyramid::build(const Map &map) {
+    _Size = map.size();
+    _Levels.clear();
+    _Changed.clear();
+    if (_Size == 0)
+        return;
+
+    /**
+     * уровни до тех пор, пока один квадрат не накроет всю карту
+     */
+    for (size_t level = 0; level == 0 || side(level - 1) > 1; level++) {
+        size_t n = side(level);
+        _Levels.emplace_back(n * n);
+        _Changed.emplace_back();
+        for (size_t y = 0; y != n; y++)
+            for (size_t x = 0; x != n; x++)
+                _Levels[level][x + y * n] = level == 0 ? _Leaf(map, x, y) : _Merge(level, x, y);
+    }
+}
+
+void LodPyramid::update(const Map &map, const std::vector<size_t> &dirty) {
+    if (dirty.empty() || _Levels.empty())
+        return;
+
+    /**
+     * затронутые квадраты уровня, от них поднимаемся к следующему
+     */
+    std::vector<size_t> cells;
+    cells.reserve(dirty.size());
+    for (size_t index: dirty)
+        cells.push_back(index % _Size / 2 + index / _Size / 2 * side(0));
+
+    for (size_t level = 0; level != levels(); level++) {
+        std::sort(cells.begin(), cells.end());
+        cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+        size_t n = side(level);
+        std::vector<size_t> next;
+        for (size_t cell: cells) {
+            size_t x = cell % n, y = cell / n;
+            cell_t value = level == 0 ? _Leaf(map, x, y) : _Merge(level, x, y);
+
+            /**
+             * квадрат не поменялся - выше тоже ничего не поменяется
+             */
+            if (value == _Levels[level][cell])
+                continue;
+            _Levels[level][cell] = value;
+            _Changed[level].push_back(cell);
+            if (level + 1 != levels())
+                next.push_back(x / 2 + y / 2 * side(level + 1));
+        }
+        if (next.empty())
+            break;
+        cells = std::move(next);
+    }
+}
+
+void LodPyramid::clearChanged() {
+    for (auto &it: _Changed)
+        it.clear();
+}
@@ -0,0 +1,89 @@
+#pragma once
+//std
+#include <cstdint>
+#include <vector>
+
+#include "map.h"
+
+/**
+ *  пирамида уровней детализации для карты издалека, как mipmap у текстур
+	уровень 0 - квадраты 2x2 клетки, каждый следующий - 2x2 квадрата предыдущего, последний - один на всю карту
+	в квадрате доля открытых клеток, есть ли флаги и есть ли взорванные бомбы, 2 байта на квадрат
+	обновляется по изменившимся клеткам карты, пересчитываются только затронутые ветки
+ */
+class LodPyramid {
+public:
+    struct cell_t {
+        /**
+         * доля открытых клеток, 0 - ни одной, 255 - все
+         */
+        uint8_t revealed = 0;
+        bool flagged: 1 = false;
+        bool exploded: 1 = false;
+
+        bool operator==(const cell_t &) const = default;
+    };
+
+    /**
+     * пирамида целиком с нуля, после генерации, загрузки или отмены многих ходов
+     */
+    void build(const Map &map);
+
+    /**
+     *  пересчёт по изменившимся клеткам, O(изменений * уровней) в худшем случае
+	    квадраты, которые поменялись, запоминаются по уровням до clearChanged
+     *  @param dirty индексы клеток x + y * size, как Map::dirty()
+     */
+    void update(const Map &map, const std::vector<size_t> &dirty);
+
+    size_t levels() const {
+        return _Levels.size();
+    }
+
+    /**
+     * сколько квадратов уровня по одной стороне
+     */
+    size_t side(size_t level) const {
+        return (_Size + span(level) - 1) / span(level);
+    }
+
+    /**
+     * сколько клеток карты по одной стороне квадрата уровня
+     */
+    static size_t span(size_t level) {
+        return size_t(2) << level;
+    }
+
+    const cell_t &at(size_t level, size_t x, size_t y) const {
+        return _Levels[level][x + y * side(level)];
+    }
+
+    /**
+     * квадраты уровня (x + y * side), поменявшиеся с последнего clearChanged, между вызовами update могут повторяться
+     */
+    const std::vector<size_t> &changed(size_t level) const {
+        return _Changed[level];
+    }
+
+    void clearChanged();
+
+private:
+    /**
+     * квадрат уровня 0 прямо по клеткам карты
+     */
+    cell_t _Leaf(const Map &map, size_t x, size_t y) const;
+
+    /**
+     * квадрат уровня level > 0 из четырёх квадратов уровня ниже, доля взвешивается по количеству клеток
+     */
+    cell_t _Merge(size_t level, size_t x, size_t y) const;
+
+    /**
+     * сколько клеток карты на самом деле под квадратом, у правого и нижнего края их меньше
+     */
+    size_t _Tiles(size_t level, size_t x, size_t y) const;
+
+    size_t _Size = 0;
+    std::vector<std::vector<cell_t>> _Levels;
+    std::vector<std::vector<size_t>> _Changed;
+};
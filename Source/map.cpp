@@ -0,0 +1,751 @@
+#include "map.h"
+#include "jobs.h"
+
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+/**
+ *  набор уровней сложности, свой выдавать нельзя
+    заполняется сразу, чтобы им могли пользоваться и утилиты без окна
+    размеры должны совпадать с EasyMap, MediumMap и HardMap из fixed_map.h
+ */
+std::array<difficulty_t, 3> difficulties = {{
+        {"Easy", 10, 8},
+        {"Medium", 20, 10},
+        {"Hard", 70, 20}
+}};
+
+/**
+ * Работа с картой
+ */
+void Map::resize(size_t level) {
+    /**
+     * собственно и взятие уровня сложности
+     */
+    auto &d = difficulties[level];
+
+    resize(d.size, Layout::RowMajor);
+}
+
+/**
+ * изменение размера карты под произвольный размер грани
+ */
+void Map::resize(size_t size, Layout layout) {
+    _Size = size;
+    _Layout = layout;
+    _Blocks = (size + BlockSize - 1) / BlockSize;
+
+    /**
+     * в блочной раскладке крайние блоки дополняются до полного размера
+     */
+    if (layout == Layout::RowMajor)
+        _Content.assign(size * size, {'n', Type::None});
+    else
+        _Content.assign(_Blocks * _Blocks * BlockSize * BlockSize, {'n', Type::None});
+
+    /**
+     * у крайних блоков клеток меньше
+     */
+    _Summary.assign(_Blocks * _Blocks, block_t());
+    markAllDirty();
+    for (size_t by = 0; by != _Blocks; by++) {
+        for (size_t bx = 0; bx != _Blocks; bx++) {
+            size_t w = std::min(BlockSize, size - bx * BlockSize);
+            size_t h = std::min(BlockSize, size - by * BlockSize);
+            _Summary[by * _Blocks + bx].tiles = w * h;
+        }
+    }
+
+    _HiddenSafe = size * size;
+    _CorrectFlags = _WrongFlags = _Exploded = 0;
+
+    _Stamp.assign(_Blocks * _Blocks, 0);
+    _ClearHistory();
+    _ClearWave();
+}
+
+/**
+ * смена состояния отрисовки клетки с обновлением сводки блока
+ */
+void Map::_SetState(size_t x, size_t y, char state) {
+    auto &tile = _Content[_Index(x, y)];
+    auto &b = _BlockOf(x, y);
+
+    if (tile.first != state && !_AllDirty)
+        _Dirty.push_back(x + y * _Size);
+    if (_Open && tile.first != state)
+        _SaveChunk(x / BlockSize, y / BlockSize);
+
+    b.revealed -= tile.first == 'r';
+    b.flagged -= tile.first == 'f';
+    _Account(tile, -1);
+    tile.first = state;
+    _Account(tile, 1);
+    b.revealed += state == 'r';
+    b.flagged += state == 'f';
+}
+
+/**
+ * смена содержимого клетки с обновлением сводки блока
+ */
+void Map::_SetType(size_t x, size_t y, Type type) {
+    auto &tile = _Content[_Index(x, y)];
+    auto &b = _BlockOf(x, y);
+
+    if (tile.second != type && !_AllDirty)
+        _Dirty.push_back(x + y * _Size);
+
+    b.bombs -= tile.second == Type::Bomb;
+    _Account(tile, -1);
+    tile.second = type;
+    _Account(tile, 1);
+    b.bombs += type == Type::Bomb;
+}
+
+/**
+ *  вклад клетки в счётчики конца игры
+    вызывается до изменения клетки с -1 и после с +1, так что счётчики всегда точные
+ */
+void Map::_Account(const Tile &tile, int sign) {
+    bool bomb = tile.second == Type::Bomb;
+    _HiddenSafe += sign * (tile.first != 'r' && !bomb);
+    _CorrectFlags += sign * (tile.first == 'f' && bomb);
+    _WrongFlags += sign * (tile.first == 'f' && !bomb);
+    _Exploded += sign * (tile.first == 'r' && bomb);
+}
+
+/**
+ *  генерация карты, включая рандомное заполнение
+	то же берёт заранее заготовленный уровень сложности из std::array <difficulty_t, 3> difficulties
+	сделано, чтобы игрок не мог проиграть с первого нажатия
+ *  @param point это точка, в которую нажал игрок
+ */
+void Map::generate(size_t level, sf::Vector2u point) {
+    auto &d = difficulties[level];
+
+    /**
+     * рандомный генератор
+     */
+    std::random_device rd;
+
+    generate(d.bombs, point, ((uint64_t) rd() << 32) | rd());
+}
+
+/**
+ * генерация с заданным количеством бомб и зерном генератора
+ */
+void Map::generate(size_t bombs, sf::Vector2u point, uint64_t seed) {
+    _Generate(bombs, point.x + point.y * _Size, seed);
+}
+
+/**
+ * генерация заранее, до первого нажатия
+ */
+void Map::generate(size_t bombs, uint64_t seed) {
+    _Generate(bombs, _Size * _Size, seed);
+}
+
+/**
+ *  сколько отмеченных попадёт в выборку draws из total, где отмечено marked (гипергеометрическое)
+    обратная функция распределения от моды, шагов порядка стандартного отклонения
+ */
+static size_t hypergeometric(Random &rng, size_t total, size_t marked, size_t draws) {
+    size_t low = draws + marked > total ? draws + marked - total : 0;
+    size_t high = std::min(draws, marked);
+    if (low == high)
+        return low;
+
+    auto logChoose = [](double n, double k) {
+        return std::lgamma(n + 1) - std::lgamma(k + 1) - std::lgamma(n - k + 1);
+    };
+
+    /**
+     * вероятность k + 1 через вероятность k
+     */
+    double N = total, K = marked, n = draws;
+    auto up = [&](double k) {
+        return (K - k) * (n - k) / ((k + 1) * (N - K - n + k + 1));
+    };
+
+    size_t mode = std::clamp<size_t>((size_t) ((n + 1) * (K + 1) / (N + 2)), low, high);
+    double pm = std::exp(logChoose(K, mode) + logChoose(N - K, n - mode) - logChoose(N, n));
+    double u = (rng() >> 11) * 0x1.0p-53;
+
+    /**
+     * от моды в обе стороны, каждый раз в сторону большей вероятности
+     */
+    u -= pm;
+    size_t lo = mode, hi = mode;
+    double plo = pm, phi = pm;
+    while (u > 0 && (lo != low || hi != high)) {
+        double next_lo = lo != low ? plo / up(lo - 1) : 0;
+        double next_hi = hi != high ? phi * up(hi) : 0;
+        if (next_hi >= next_lo) {
+            phi = next_hi;
+            u -= phi;
+            if (u <= 0)
+                return hi + 1;
+            hi++;
+        } else {
+            plo = next_lo;
+            u -= plo;
+            if (u <= 0)
+                return lo - 1;
+            lo--;
+        }
+    }
+    return mode;
+}
+
+void Map::generate(size_t bombs, uint64_t seed, alone::JobSystem &jobs) {
+    _Bombs = bombs;
+    markAllDirty();
+    _ClearHistory();
+    _ClearWave();
+
+    size_t strips = (_Size + StripRows - 1) / StripRows;
+    auto rows = [&](size_t strip) {
+        return std::min(StripRows, _Size - strip * StripRows);
+    };
+
+    /**
+     *  доли бомб и зёрна полос выбираются в одном потоке по порядку
+	    каждая следующая доля - гипергеометрическая от того, что осталось
+     */
+    Random rng(seed);
+    std::vector<size_t> share(strips);
+    std::vector<uint64_t> seeds(strips);
+    size_t cellsLeft = _Size * _Size, bombsLeft = bombs;
+    for (size_t i = 0; i != strips; i++) {
+        size_t cells = rows(i) * _Size;
+        share[i] = hypergeometric(rng, cellsLeft, bombsLeft, cells);
+        seeds[i] = rng();
+        cellsLeft -= cells;
+        bombsLeft -= share[i];
+    }
+
+    /**
+     * первый проход: полоса чистится и в неё ставятся её бомбы алгоритмом Флойда
+     */
+    std::vector<std::vector<size_t>> mines(strips);
+    std::vector<uint8_t> bomb(_Size * _Size);
+    jobs.parallelFor(0, strips, 1, [&](size_t from, size_t to) {
+        for (size_t i = from; i != to; i++) {
+            _GenerateStrip(i, rows(i), share[i], seeds[i], mines[i]);
+            for (size_t pos: mines[i])
+                bomb[pos] = 1;
+        }
+    });
+
+    /**
+     *  второй проход: числа считаются от клетки по карте бомб из первого прохода
+	    соседние полосы в это время пишут свои числа в _Content, поэтому на стыках _Content читать нельзя,
+	    а карту бомб второй проход только читает
+     */
+    auto hasBomb = [&](size_t x, size_t y) -> size_t {
+        return x < _Size && y < _Size && bomb[x + y * _Size];
+    };
+    jobs.parallelFor(0, strips, 1, [&](size_t from, size_t to) {
+        for (size_t y = from * StripRows; y != std::min(_Size, to * StripRows); y++)
+            for (size_t x = 0; x != _Size; x++) {
+                if (bomb[x + y * _Size])
+                    continue;
+                size_t around = hasBomb(x - 1, y - 1) + hasBomb(x, y - 1) + hasBomb(x + 1, y - 1) +
+                                hasBomb(x - 1, y) + hasBomb(x + 1, y) +
+                                hasBomb(x - 1, y + 1) + hasBomb(x, y + 1) + hasBomb(x + 1, y + 1);
+                _Content[_Index(x, y)].second = around ? (Type) (around - 1) : Type::None;
+            }
+    });
+
+    _Mines.clear();
+    for (auto &it: mines)
+        _Mines.insert(_Mines.end(), it.begin(), it.end());
+
+    _HiddenSafe = _Size * _Size - bombs;
+    _CorrectFlags = _WrongFlags = _Exploded = 0;
+}
+
+void Map::_GenerateStrip(size_t strip, size_t count, size_t share, uint64_t seed, std::vector<size_t> &mines) {
+    size_t top = strip * StripRows, bottom = top + count;
+    for (size_t y = top; y != bottom; y++)
+        for (size_t x = 0; x != _Size; x++)
+            _Content[_Index(x, y)] = {'n', Type::None};
+    for (size_t by = top / BlockSize; by != (bottom + BlockSize - 1) / BlockSize; by++)
+        for (size_t bx = 0; bx != _Blocks; bx++) {
+            auto &b = _Summary[by * _Blocks + bx];
+            b.revealed = b.flagged = b.bombs = 0;
+        }
+
+    Random local(seed);
+    size_t cells = count * _Size, first = top * _Size;
+    mines.clear();
+    for (size_t j = cells - share; j != cells; j++) {
+        size_t pos = first + local.upTo(j);
+        if (_Content[_Index(pos % _Size, pos / _Size)].second == Type::Bomb)
+            pos = first + j;
+
+        /**
+         * сводки блоков у полос свои, так что писать можно без _SetType
+         */
+        _Content[_Index(pos % _Size, pos / _Size)].second = Type::Bomb;
+        _BlockOf(pos % _Size, pos / _Size).bombs++;
+        mines.push_back(pos);
+    }
+}
+
+void Map::_Generate(size_t bombs, size_t skip, uint64_t seed) {
+    _Bombs = bombs;
+
+    _Clear();
+
+    Random rng(seed);
+
+    /**
+     *  клетки нумеруются так, что элемент с индексом 0 - это левый верхний
+	    а с индексом 10 при ширине в 8 тайлов - это элемент с 'x = 2' и 'y = 1'
+	    точку, в которую тыкнул игрок, просто пропускаем при нумерации
+     */
+    size_t cells = _Size * _Size - (skip < _Size * _Size);
+    auto cell = [&](size_t i) {
+        return i < skip ? i : i + 1;
+    };
+
+    /**
+     *  заполнение бомб алгоритмом Флойда
+	    раньше брали случайный элемент из std::set через std::advance, это было квадратично
+	    здесь каждая бомба ставится за O(1) и без дополнительной памяти
+     */
+    for (size_t j = cells - bombs; j != cells; j++) {
+        size_t pos = cell(rng.upTo(j));
+
+        /**
+         * если тут уже есть бомба, то ставим в клетку j, она точно свободна
+         */
+        if (_HasBomb(pos % _Size, pos / _Size))
+            pos = cell(j);
+
+        _SetType(pos % _Size, pos / _Size, Type::Bomb);
+        _Mines.push_back(pos);
+    }
+
+    _FillNumbers();
+}
+
+/**
+ * расстановка готовых бомб, например из набора карт или сохранения
+ */
+void Map::place(const std::vector<size_t> &mines) {
+    _Clear();
+    _Bombs = mines.size();
+
+    for (size_t pos: mines) {
+        _SetType(pos % _Size, pos / _Size, Type::Bomb);
+        _Mines.push_back(pos);
+    }
+
+    _FillNumbers();
+}
+
+/**
+ * карта могла уже использоваться, поэтому чистим её, память при этом не трогаем
+ */
+void Map::_Clear() {
+    markAllDirty();
+    std::fill(_Content.begin(), _Content.end(), Tile('n', Type::None));
+    for (auto &it: _Summary)
+        it.revealed = it.flagged = it.bombs = 0;
+    _Mines.clear();
+    _HiddenSafe = _Size * _Size;
+    _CorrectFlags = _WrongFlags = _Exploded = 0;
+    _ClearHistory();
+    _ClearWave();
+}
+
+/**
+ *  заполнение чисел вокруг бомб из _Mines
+    каждая бомба прибавляет единицу соседям, так выходит O(бомб), а не O(клеток)
+ */
+void Map::_FillNumbers() {
+    for (size_t pos: _Mines) {
+        size_t x = pos % _Size, y = pos / _Size;
+        for (size_t ny = y ? y - 1 : 0; ny <= y + 1 && ny < _Size; ny++) {
+            for (size_t nx = x ? x - 1 : 0; nx <= x + 1 && nx < _Size; nx++) {
+                Type type = at(nx, ny).second;
+                if (type == Type::Bomb)
+                    continue;
+
+                /**
+                 * пустая клетка становится единицей, а число увеличивается на один
+                 */
+                _SetType(nx, ny, type == Type::None ? Type::Number1 : (Type) ((size_t) type + 1));
+            }
+        }
+    }
+}
+
+/**
+ *  перенос бомбы с пересчётом чисел только в двух окрестностях 3x3
+    на месте бомбы остаётся число по её новым соседям
+ */
+void Map::moveMine(size_t mine, size_t to) {
+    size_t from = _Mines[mine];
+    _Mines[mine] = to;
+
+    _SetType(from % _Size, from / _Size, Type::None);
+    _Shift(from % _Size, from / _Size, -1);
+
+    _SetType(to % _Size, to / _Size, Type::Bomb);
+    _Shift(to % _Size, to / _Size, 1);
+
+    size_t around = _DetectAround(from % _Size, from / _Size);
+    _SetType(from % _Size, from / _Size, around ? (Type) (around - 1) : Type::None);
+}
+
+/**
+ *  бомбы из точки нажатия (и её соседей для opening) уходят в случайные свободные клетки
+    трогаются только бомбы внутри области, остальная карта остаётся как была
+ */
+bool Map::makeSafe(sf::Vector2u point, uint64_t seed, bool opening) {
+    size_t radius = opening ? 1 : 0;
+    auto inside = [&](size_t x, size_t y) {
+        return x + radius >= point.x && x <= point.x + radius && y + radius >= point.y && y <= point.y + radius;
+    };
+
+    /**
+     * область целиком и все бомбы должны помещаться в остальную карту
+     */
+    size_t area = 0;
+    for (size_t y = point.y - std::min<size_t>(point.y, radius); y <= point.y + radius && y < _Size; y++)
+        for (size_t x = point.x - std::min<size_t>(point.x, radius); x <= point.x + radius && x < _Size; x++)
+            area++;
+    if (_Size * _Size - area < _Mines.size())
+        return false;
+
+    Random rng(seed);
+    for (size_t k = 0; k != _Mines.size(); k++) {
+        size_t pos = _Mines[k];
+        if (!inside(pos % _Size, pos / _Size))
+            continue;
+
+        /**
+         * свободных клеток вне области хватает, так что поиск заканчивается
+         */
+        size_t to;
+        do
+            to = rng.upTo(_Size * _Size - 1);
+        while (_HasBomb(to % _Size, to / _Size) || inside(to % _Size, to / _Size));
+
+        moveMine(k, to);
+    }
+    return true;
+}
+
+/**
+ * прибавляет delta к числам соседей клетки, бомбы не трогает
+ */
+void Map::_Shift(size_t x, size_t y, int delta) {
+    for (size_t ny = y ? y - 1 : 0; ny <= y + 1 && ny < _Size; ny++) {
+        for (size_t nx = x ? x - 1 : 0; nx <= x + 1 && nx < _Size; nx++) {
+            Type type = at(nx, ny).second;
+            if (type == Type::Bomb || (nx == x && ny == y))
+                continue;
+
+            size_t value = (type == Type::None ? 0 : (size_t) type + 1) + delta;
+            _SetType(nx, ny, value ? (Type) (value - 1) : Type::None);
+        }
+    }
+}
+
+bool Map::reveal(size_t x, size_t y) {
+    auto &tile = at(x, y);
+
+    /**
+     *  закрытую клетку могла открыть ещё идущая заливка, поэтому сначала она доделывается
+	    так результат хода не зависит от того, как быстро шла анимация, и совпадает с повтором
+     */
+    if (tile.first == 'n' && flooding())
+        finish();
+    if (tile.first != 'n')
+        return false;
+
+    /**
+     * если тут пусто, то открываем рядом пустые тайлы до цифр
+     */
+    if (tile.second == Type::None)
+        _OpenTiles(x, y);
+    else
+        _SetState(x, y, 'r');
+
+    return tile.second == Type::Bomb;
+}
+
+char Map::toggleFlag(size_t x, size_t y) {
+    if (at(x, y).first == 'n' && flooding())
+        finish();
+    char state = at(x, y).first;
+    if (state == 'f')
+        _SetState(x, y, 'n');
+    else if (state == 'n')
+        _SetState(x, y, 'f');
+    return at(x, y).first;
+}
+
+void Map::setHistory(bool enabled) {
+    _History = enabled;
+    _ClearHistory();
+}
+
+void Map::setProgressive(bool enabled) {
+    _Progressive = enabled;
+    if (!enabled)
+        finish();
+}
+
+size_t Map::step(size_t budget) {
+    return _Flood(budget);
+}
+
+void Map::_ClearWave() {
+    _Wave.clear();
+    _Head = 0;
+}
+
+void Map::beginMove() {
+    if (!_History)
+        return;
+
+    /**
+     * заливка прошлого хода не должна попасть в следующий шаг истории
+     */
+    finish();
+
+    /**
+     * пустой прошлый ход (клик, который ничего не поменял) переиспользуется
+     */
+    if (_Undo.empty() || !_Undo.back().chunks.empty())
+        _Undo.emplace_back();
+
+    auto &step = _Undo.back();
+    step.bombs = _Bombs;
+    step.hiddenSafe = _HiddenSafe;
+    step.correctFlags = _CorrectFlags;
+    step.wrongFlags = _WrongFlags;
+    step.exploded = _Exploded;
+
+    _Step++;
+    _Open = true;
+}
+
+void Map::_SaveChunk(size_t bx, size_t by) {
+    size_t block = by * _Blocks + bx;
+    if (_Stamp[block] == _Step)
+        return;
+    _Stamp[block] = _Step;
+
+    /**
+     * ход что-то поменял, значит отменённые ходы вернуть уже нельзя
+     */
+    _Redo.clear();
+
+    auto &chunk = _Undo.back().chunks.emplace_back();
+    chunk.block = block;
+    chunk.summary = _Summary[block];
+    for (size_t dy = 0; dy != BlockSize; dy++)
+        for (size_t dx = 0; dx != BlockSize; dx++) {
+            size_t x = bx * BlockSize + dx, y = by * BlockSize + dy;
+            chunk.states[dy * BlockSize + dx] = x < _Size && y < _Size ? at(x, y).first : 'n';
+        }
+}
+
+void Map::_SwapStep(step_t &step) {
+    for (auto &chunk: step.chunks) {
+        size_t bx = chunk.block % _Blocks, by = chunk.block / _Blocks;
+        std::swap(_Summary[chunk.block], chunk.summary);
+
+        for (size_t dy = 0; dy != BlockSize; dy++)
+            for (size_t dx = 0; dx != BlockSize; dx++) {
+                size_t x = bx * BlockSize + dx, y = by * BlockSize + dy;
+                if (x >= _Size || y >= _Size)
+                    continue;
+
+                auto &state = _Content[_Index(x, y)].first;
+                if (state != chunk.states[dy * BlockSize + dx] && !_AllDirty)
+                    _Dirty.push_back(x + y * _Size);
+                std::swap(state, chunk.states[dy * BlockSize + dx]);
+            }
+    }
+
+    std::swap(_Bombs, step.bombs);
+    std::swap(_HiddenSafe, step.hiddenSafe);
+    std::swap(_CorrectFlags, step.correctFlags);
+    std::swap(_WrongFlags, step.wrongFlags);
+    std::swap(_Exploded, step.exploded);
+}
+
+bool Map::undo() {
+    finish();
+    _Open = false;
+    while (!_Undo.empty() && _Undo.back().chunks.empty())
+        _Undo.pop_back();
+    if (_Undo.empty())
+        return false;
+
+    _SwapStep(_Undo.back());
+    _Redo.push_back(std::move(_Undo.back()));
+    _Undo.pop_back();
+    return true;
+}
+
+bool Map::redo() {
+    finish();
+    _Open = false;
+    if (_Redo.empty())
+        return false;
+
+    _SwapStep(_Redo.back());
+    _Undo.push_back(std::move(_Redo.back()));
+    _Redo.pop_back();
+    return true;
+}
+
+size_t Map::historyBytes() const {
+    size_t bytes = (_Undo.capacity() + _Redo.capacity()) * sizeof(step_t);
+    for (auto *steps: {&_Undo, &_Redo})
+        for (auto &step: *steps)
+            bytes += step.chunks.capacity() * sizeof(chunk_t);
+    return bytes;
+}
+
+void Map::_ClearHistory() {
+    _Undo.clear();
+    _Redo.clear();
+    _Open = false;
+}
+
+/**
+ * проверяет, есть ли бомба по заданному индексу
+ * @return если выходит индекс за пределы карты, то возвращает false
+ */
+bool Map::_HasBomb(size_t x, size_t y) const {
+    /**
+     * отрицательные индексы после приведения к size_t становятся огромными, так что хватает одной проверки
+     */
+    if (x >= _Size || y >= _Size)
+        return false;
+    return at(x, y).second == Type::Bomb;
+}
+
+/**
+ * проверяет все клетки сверху, снизу, по бокам и по диагонали
+ * @return
+ */
+size_t Map::_DetectAround(size_t x, size_t y) const {
+    return _HasBomb(x - 1, y - 1) + _HasBomb(x, y - 1) + _HasBomb(x + 1, y - 1) +
+           _HasBomb(x - 1, y) + _HasBomb(x + 1, y) +
+           _HasBomb(x - 1, y + 1) + _HasBomb(x, y + 1) + _HasBomb(x + 1, y + 1);
+}
+
+/**
+ *  открывает тайлы вокруг нажатого
+    продолжаем обход только в том случае, если открыли пустой тайл
+ */
+void Map::_OpenTiles(int x, int y) {
+    _Wave.emplace_back(x, y);
+    if (!_Progressive)
+        _Flood();
+}
+
+/**
+ *  обход в ширину от всех клеток, которые лежат в _Wave
+	очередь - вектор с головой, так что заливка идёт кольцами от точки нажатия
+ */
+size_t Map::_Flood(size_t budget) {
+    for (; _Head != _Wave.size() && budget != 0; budget--) {
+        auto [cx, cy] = _Wave[_Head++];
+
+        if (cy >= (int) _Size || cy < 0 || cx >= (int) _Size || cx < 0)
+            continue;
+
+        auto &tile = at(cx, cy);
+
+        /**
+         * флаги обход не открывает, их снимает только сам игрок
+         */
+        if (tile.first == 'f')
+            continue;
+
+        if (tile.first == 'r' || tile.second != Type::None) {
+
+            /**
+             * ставит статус revealed - проверено
+             */
+            _SetState(cx, cy, 'r');
+            continue;
+        }
+
+        /**
+         * ставит статус revealed - проверено
+         */
+        _SetState(cx, cy, 'r');
+
+        /**
+         * проверка верхних, по бокам и нижних
+         */
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++)
+                if (dx || dy)
+                    _Wave.emplace_back(cx + dx, cy + dy);
+    }
+
+    /**
+     * пройденное начало очереди выкидывается, когда его больше половины, иначе очередь росла бы на всю заливку
+     */
+    if (_Head == _Wave.size())
+        _ClearWave();
+    else if (_Head > 4096 && _Head * 2 > _Wave.size()) {
+        _Wave.erase(_Wave.begin(), _Wave.begin() + _Head);
+        _Head = 0;
+    }
+    return _Wave.size() - _Head;
+}
+
+bool Map::chord(size_t x, size_t y) {
+    auto &tile = at(x, y);
+    if (tile.first != 'r' || tile.second > Type::Number8)
+        return false;
+
+    /**
+     * число должно быть закрыто флагами полностью
+     */
+    size_t flags = 0;
+    for (size_t ny = y ? y - 1 : 0; ny <= y + 1 && ny < _Size; ny++)
+        for (size_t nx = x ? x - 1 : 0; nx <= x + 1 && nx < _Size; nx++)
+            flags += at(nx, ny).first == 'f';
+    if (flags != (size_t) tile.second + 1)
+        return false;
+
+    /**
+     * все закрытые соседи идут в один обход, а не в восемь отдельных
+     */
+    bool bomb = false;
+    for (size_t ny = y ? y - 1 : 0; ny <= y + 1 && ny < _Size; ny++) {
+        for (size_t nx = x ? x - 1 : 0; nx <= x + 1 && nx < _Size; nx++) {
+            if (at(nx, ny).first != 'n')
+                continue;
+
+            /**
+             * флаг стоял не там, игрок открывает бомбу
+             */
+            if (at(nx, ny).second == Type::Bomb) {
+                bomb = true;
+                _SetState(nx, ny, 'r');
+            } else
+                _Wave.emplace_back(nx, ny);
+        }
+    }
+    if (!_Progressive)
+        _Flood();
+
+    return bomb;
+}
@@ -0,0 +1,629 @@
+#pragma once
+//std
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <concepts>
+
+//sfml
+#include <SFML/System/Vector2.hpp>
+
+#define DEBUG_MODE 0
+
+namespace alone {
+    class JobSystem;
+}
+
+/**
+ * для удобной нумерации текстур
+ * uint8_t, чтобы клетка карты занимала 2 байта, а не 8
+ */
+enum class Type : uint8_t {
+    Number1 = 0,
+    Number2 = 1,
+    Number3,
+    Number4,
+    Number5,
+    Number6,
+    Number7,
+    Number8,
+    None,
+    Unknown,
+    Flag,
+    NoBomb,
+    NoneQuiestion,
+    UnknownQuestion,
+    Bomb,
+    RedBomb
+};
+
+/**
+ * класс для удобного хранения уровня сложности
+ */
+struct difficulty_t {
+
+    /**
+     * имя уровня сложности
+     */
+    std::string name;
+
+    /**
+     * количество бомб на карте
+     */
+    size_t bombs;
+
+    /**
+     * размер грани карты, карта может быть только квадратная
+     */
+    size_t size;
+};
+
+/**
+ * набор уровней сложности, свой выдавать нельзя
+ */
+extern std::array<difficulty_t, 3> difficulties;
+
+/**
+ *  быстрый генератор случайных чисел splitmix64
+    std::mt19937_64 создаётся дольше, чем генерируется целая карта Easy
+    и в отличие от std::uniform_int_distribution даёт одни и те же карты на всех компиляторах
+ */
+struct Random {
+    using result_type = uint64_t;
+
+    explicit Random(uint64_t seed) : _State(seed) {}
+
+    static constexpr uint64_t min() {
+        return 0;
+    }
+
+    static constexpr uint64_t max() {
+        return UINT64_MAX;
+    }
+
+    uint64_t operator()() {
+        uint64_t z = (_State += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    /**
+     *  число от 0 до n включительно, без перекоса остатка от деления
+	    метод Лемира: старшая половина произведения x * (n + 1), а младшие, попавшие в неполный хвост, отбрасываются
+	    деление нужно только в редком случае, когда младшая половина меньше n + 1
+     */
+    uint64_t upTo(uint64_t n) {
+        uint64_t range = n + 1;
+        if (range == 0)
+            return (*this)();
+
+        uint64_t low, high = _MulHigh((*this)(), range, low);
+        if (low < range) {
+            uint64_t threshold = (0 - range) % range;
+            while (low < threshold)
+                high = _MulHigh((*this)(), range, low);
+        }
+        return high;
+    }
+
+private:
+    /**
+     * произведение 64 x 64 -> 128 без __int128, которого нет в MSVC, чтобы карты не зависели от компилятора
+     */
+    static uint64_t _MulHigh(uint64_t a, uint64_t b, uint64_t &low) {
+        uint64_t aLow = a & 0xffffffffull, aHigh = a >> 32;
+        uint64_t bLow = b & 0xffffffffull, bHigh = b >> 32;
+        uint64_t ll = aLow * bLow, lh = aLow * bHigh, hl = aHigh * bLow, hh = aHigh * bHigh;
+        uint64_t middle = (ll >> 32) + (lh & 0xffffffffull) + (hl & 0xffffffffull);
+        low = a * b;
+        return hh + (lh >> 32) + (hl >> 32) + (middle >> 32);
+    }
+
+    uint64_t _State;
+};
+
+/**
+ * класс карты игры
+ */
+class Map {
+    /**
+     * позволяет работать с картой игры не напрямую
+     */
+    friend class GameState;
+
+public:
+
+    /**
+     * клетка карты: состояние отрисовки и что в ней лежит
+     * n - unknown, r - revealed, f - flag
+     */
+    using Tile = std::pair<char, Type>;
+
+    /**
+     * как клетки лежат в памяти
+     * RowMajor - строка за строкой
+     * Tiled - блоками 8x8, каждый блок лежит в памяти целиком, соседи почти всегда в одной кэш-линии
+     */
+    enum class Layout {
+        RowMajor,
+        Tiled
+    };
+
+    /**
+     * сторона блока, для которого считается сводка
+     */
+    static constexpr size_t BlockSize = 8;
+
+    /**
+     * сводка по блоку, чтобы массовые операции могли пропускать блоки целиком
+     */
+    struct block_t {
+        uint8_t tiles = 0;
+        uint8_t revealed = 0;
+        uint8_t flagged = 0;
+        uint8_t bombs = 0;
+    };
+
+    /**
+     *  изменение размера карты игры в зависимости от уровня сложности
+     */
+    void resize(size_t level);
+
+    /**
+     * изменение размера карты под произвольный размер грани
+     */
+    void resize(size_t size, Layout layout);
+
+    /**
+     *  генерация карты, включая рандомное заполнение
+	    то же берёт заранее заготовленный уровень сложности из std::array <difficulty_t, 3> difficulties
+	    сделано, чтобы игрок не мог проиграть с первого нажатия
+     *  @param point точка, в которую нажал игрок
+     */
+    void generate(size_t level, sf::Vector2u point);
+
+    /**
+     * генерация с заданным количеством бомб и зерном генератора
+     * одинаковое зерно даёт одинаковую карту при любой раскладке
+     */
+    void generate(size_t bombs, sf::Vector2u point, uint64_t seed);
+
+    /**
+     *  генерация без точки нажатия, карта готова ещё до первого клика
+	    безопасность первого клика потом обеспечивает makeSafe
+     */
+    void generate(size_t bombs, uint64_t seed);
+
+    /**
+     *  генерация огромной карты в несколько потоков
+	    карта режется на полосы по StripRows строк, доли бомб по полосам выбираются заранее
+	    (многомерное гипергеометрическое распределение), у каждой полосы свой генератор
+	    потом вторым проходом считаются числа, в том числе на стыках полос
+	    при одном зерне карта одна и та же при любом размере пула, но не та же, что у generate(bombs, seed)
+     *  @param jobs пул, по которому раздаются полосы, без рабочих потоков всё идёт в текущем
+     */
+    void generate(size_t bombs, uint64_t seed, alone::JobSystem &jobs);
+
+    /**
+     * высота полосы для многопоточной генерации, кратна BlockSize, чтобы полосы не делили блоки
+     */
+    static constexpr size_t StripRows = 256;
+
+    /**
+     *  переносит бомбу номер mine из mines() в клетку to (x + y * size), где бомбы быть не должно
+	    числа пересчитываются только вокруг старой и новой клетки, так что это O(1)
+	    годится и для генераторов, которые двигают бомбы по одной
+     */
+    void moveMine(size_t mine, size_t to);
+
+    /**
+     *  убирает бомбы из точки нажатия в случайные свободные клетки
+     *  @param seed зерно для выбора новых клеток, лучше не то же, что у generate
+     *  @param opening очистить ещё и соседей, тогда первый клик всегда открывает область
+     *  @return false, если на карте не хватает места, тогда карта не меняется
+     */
+    bool makeSafe(sf::Vector2u point, uint64_t seed, bool opening = false);
+
+    /**
+     *  расстановка готовых бомб и подсчёт чисел
+     *  @param mines индексы клеток с бомбами, x + y * size
+     */
+    void place(const std::vector<size_t> &mines);
+
+    /**
+     *  открывает закрытую клетку, как левый клик
+	    если клетка пустая, то открываются и соседние
+     *  @return true, если в клетке была бомба
+     */
+    bool reveal(size_t x, size_t y);
+
+    /**
+     *  ставит флаг на закрытую клетку или снимает его, открытые клетки не трогает
+     *  @return новое состояние клетки
+     */
+    char toggleFlag(size_t x, size_t y);
+
+    /**
+     *  аккорд: если вокруг открытого числа стоит ровно столько флагов, то открываются все остальные соседи
+	    все соседи открываются одним обходом
+     *  @return true, если среди открытых оказалась бомба
+     */
+    bool chord(size_t x, size_t y);
+
+    /**
+     *  постепенное открытие: reveal и chord только ставят клетки в очередь, а открывает их step
+	    счётчики и dirty всегда соответствуют тому, что уже открыто
+	    ход по закрытой клетке сначала доделывает заливку, ход по открытой - нет, он не может с ней разойтись
+	    выключение доделывает заливку сразу
+     */
+    void setProgressive(bool enabled);
+
+    bool progressive() const {
+        return _Progressive;
+    }
+
+    /**
+     * идёт ли ещё заливка
+     */
+    bool flooding() const {
+        return _Head != _Wave.size();
+    }
+
+    /**
+     *  разбирает не больше budget клеток очереди заливки
+     *  @return сколько ещё осталось
+     */
+    size_t step(size_t budget);
+
+    /**
+     * доделывает заливку целиком
+     */
+    void finish() {
+        _Flood();
+    }
+
+    /**
+     *  клетки (x + y * size), изменившиеся с последнего clearDirty
+	    по ним отрисовка обновляет только то, что поменялось
+     */
+    const std::vector<size_t> &dirty() const {
+        return _Dirty;
+    }
+
+    /**
+     * изменилась вся карта сразу, например после генерации, и список клеток не ведётся
+     */
+    bool allDirty() const {
+        return _AllDirty;
+    }
+
+    void markAllDirty() {
+        _AllDirty = true;
+        _Dirty.clear();
+    }
+
+    void clearDirty() {
+        _AllDirty = false;
+        _Dirty.clear();
+    }
+
+    /**
+     *  история ходов для отмены, нужна режиму тренировки, по умолчанию выключена
+	    ход хранит копии только тех блоков 8x8, которые он поменял, копия делается при первом изменении блока
+	    так что память хода пропорциональна тому, что он поменял, а не размеру карты
+	    новая генерация или resize историю стирают
+     */
+    void setHistory(bool enabled);
+
+    bool history() const {
+        return _History;
+    }
+
+    /**
+     * начало нового хода, все изменения до следующего beginMove отменяются вместе
+     */
+    void beginMove();
+
+    /**
+     *  отмена последнего хода за O(изменённых блоков), блоки меняются местами с копиями
+	    поэтому тот же ход потом можно вернуть через redo
+     *  @return false, если отменять нечего
+     */
+    bool undo();
+
+    bool redo();
+
+    /**
+     * сколько памяти занимает история
+     */
+    size_t historyBytes() const;
+
+    /**
+     *  закрытые клетки без бомб, когда их 0 - игрок выиграл
+	    все счётчики ведутся в _SetState и _SetType, так что проверки конца игры стоят O(1)
+     */
+    size_t hiddenSafe() const {
+        return _HiddenSafe;
+    }
+
+    /**
+     * флаги, стоящие на бомбах
+     */
+    size_t correctFlags() const {
+        return _CorrectFlags;
+    }
+
+    /**
+     * флаги, стоящие не на бомбах
+     */
+    size_t wrongFlags() const {
+        return _WrongFlags;
+    }
+
+    /**
+     * открытые бомбы, если не 0 - игрок проиграл
+     */
+    size_t exploded() const {
+        return _Exploded;
+    }
+
+    /**
+     * индексы бомб (x + y * size) в порядке расстановки
+     */
+    const std::vector<size_t> &mines() const {
+        return _Mines;
+    }
+
+    /**
+     * размер грани карты
+     */
+    size_t size() const {
+        return _Size;
+    }
+
+    /**
+     * раскладка карты в памяти
+     */
+    Layout layout() const {
+        return _Layout;
+    }
+
+    /**
+     * доступ к клетке, менять клетки можно только через _SetState и _SetType
+     */
+    const Tile &at(size_t x, size_t y) const {
+        return _Content[_Index(x, y)];
+    }
+
+    /**
+     * количество блоков по одной грани
+     */
+    size_t blocks() const {
+        return _Blocks;
+    }
+
+    /**
+     * сводка блока по его координатам
+     */
+    const block_t &block(size_t bx, size_t by) const {
+        return _Summary[by * _Blocks + bx];
+    }
+
+    /**
+     * в блоке нет ни открытых клеток, ни флагов
+     */
+    bool _BlockHidden(size_t bx, size_t by) const {
+        auto &b = block(bx, by);
+        return b.revealed == 0 && b.flagged == 0;
+    }
+
+    /**
+     * весь блок открыт
+     */
+    bool _BlockRevealed(size_t bx, size_t by) const {
+        auto &b = block(bx, by);
+        return b.revealed == b.tiles;
+    }
+
+    /**
+     * в блоке есть хотя бы одна бомба
+     */
+    bool _BlockHasBomb(size_t bx, size_t by) const {
+        return block(bx, by).bombs != 0;
+    }
+
+    /**
+     * смена состояния отрисовки клетки с обновлением сводки блока
+     */
+    void _SetState(size_t x, size_t y, char state);
+
+    /**
+     * смена содержимого клетки с обновлением сводки блока
+     */
+    void _SetType(size_t x, size_t y, Type type);
+
+    /**
+     * костыль из использования char'а как состояния для отрисовки
+     * в памяти лежит в порядке, который задаёт _Layout
+     */
+    //n - unknown, r - revealed, f - flag
+    std::vector<Tile> _Content;
+
+    /**
+     * кол-во бомб на карте
+     */
+    size_t _Bombs = 0;
+
+    /**
+     * проверяет, есть ли бомба по заданному индексу
+     * @return если выходит индекс за пределы карты, то возвращает false
+     */
+    bool _HasBomb(size_t x, size_t y) const;
+
+    /**
+     * проверяет все клетки сверху, снизу, побокам и по диагонали
+     */
+    size_t _DetectAround(size_t x, size_t y) const;
+
+    /**
+     *  открывает тайлы вокруг нажатого
+        раньше был рекурсивным, но на больших картах кончался стек, теперь идёт по своему стеку
+     */
+    void _OpenTiles(int x, int y);
+
+private:
+
+    /**
+     * закрывает и очищает все клетки, не освобождая память
+     */
+    void _Clear();
+
+    /**
+     * расстановка bombs бомб алгоритмом Флойда, клетка skip остаётся свободной
+     */
+    void _Generate(size_t bombs, size_t skip, uint64_t seed);
+
+    /**
+     *  первый проход многопоточной генерации: чистит полосу из count строк и ставит в неё share бомб
+	    полосы не делят блоки, поэтому разные полосы можно делать одновременно
+     */
+    void _GenerateStrip(size_t strip, size_t count, size_t share, uint64_t seed, std::vector<size_t> &mines);
+
+    /**
+     * подсчёт чисел вокруг бомб из _Mines
+     */
+    void _FillNumbers();
+
+    /**
+     * изменение чисел вокруг клетки на delta, когда рядом появилась или пропала бомба
+     */
+    void _Shift(size_t x, size_t y, int delta);
+
+    /**
+     *  обход от всех клеток из _Wave, открывает пустые области до цифр
+     *  @param budget сколько клеток очереди разобрать, по умолчанию все
+     *  @return сколько осталось в очереди
+     */
+    size_t _Flood(size_t budget = -1);
+
+    void _ClearWave();
+
+    /**
+     * добавляет (sign = 1) или убирает (sign = -1) клетку из счётчиков конца игры
+     */
+    void _Account(const Tile &tile, int sign);
+
+    /**
+     * копия состояний одного блока до хода
+     */
+    struct chunk_t {
+        uint32_t block;
+        block_t summary;
+        std::array<char, BlockSize * BlockSize> states;
+    };
+
+    /**
+     * один ход истории: изменённые блоки и счётчики карты до хода
+     */
+    struct step_t {
+        std::vector<chunk_t> chunks;
+        size_t bombs, hiddenSafe, correctFlags, wrongFlags, exploded;
+    };
+
+    /**
+     * копирует блок в текущий ход, если в этом ходу он ещё не копировался
+     */
+    void _SaveChunk(size_t bx, size_t by);
+
+    /**
+     * меняет местами карту и содержимое хода, это и отмена, и возврат
+     */
+    void _SwapStep(step_t &step);
+
+    void _ClearHistory();
+
+    /**
+     * перевод координат в индекс в _Content в зависимости от раскладки
+     */
+    size_t _Index(size_t x, size_t y) const {
+        if (_Layout == Layout::RowMajor)
+            return y * _Size + x;
+        return (((y / BlockSize) * _Blocks + x / BlockSize) * BlockSize + y % BlockSize) * BlockSize + x % BlockSize;
+    }
+
+    /**
+     * сводка блока, в котором лежит клетка
+     */
+    block_t &_BlockOf(size_t x, size_t y) {
+        return _Summary[(y / BlockSize) * _Blocks + x / BlockSize];
+    }
+
+    size_t _Size = 0;
+
+    size_t _Blocks = 0;
+
+    Layout _Layout = Layout::RowMajor;
+
+    std::vector<block_t> _Summary;
+
+    size_t _HiddenSafe = 0;
+    size_t _CorrectFlags = 0;
+    size_t _WrongFlags = 0;
+    size_t _Exploded = 0;
+
+    /**
+     * индексы бомб (x + y * size) с последней генерации
+     */
+    std::vector<size_t> _Mines;
+
+    /**
+     *  очередь обхода для _OpenTiles, хранится тут, чтобы не выделять память на каждый клик
+	    при постепенном открытии переживает кадры, _Head - первый ещё не разобранный элемент
+     */
+    std::vector<std::pair<int, int>> _Wave;
+    size_t _Head = 0;
+    bool _Progressive = false;
+
+    /**
+     * изменённые клетки для dirty(), пока _AllDirty не ведутся
+     */
+    std::vector<size_t> _Dirty;
+
+    bool _AllDirty = true;
+
+    bool _History = false;
+
+    /**
+     * открыт ли сейчас ход, изменения вне хода в историю не попадают
+     */
+    bool _Open = false;
+
+    std::vector<step_t> _Undo, _Redo;
+
+    /**
+     * номер хода, в котором блок копировался последний раз, чтобы не копировать его дважды
+     */
+    std::vector<uint32_t> _Stamp;
+    uint32_t _Step = 0;
+};
+
+/**
+ *  общий интерфейс карты, его реализуют и Map, и FixedMap
+    боты и симуляции пишутся шаблоном над ним
+ */
+template<class T>
+concept Board = requires(T board, const T &view, size_t x, sf::Vector2u point, uint64_t seed) {
+    { view.size() } -> std::convertible_to<size_t>;
+    { view.at(x, x) } -> std::same_as<const Map::Tile &>;
+    { view._HasBomb(x, x) } -> std::same_as<bool>;
+    { view._DetectAround(x, x) } -> std::same_as<size_t>;
+    { view.hiddenSafe() } -> std::convertible_to<size_t>;
+    board._SetState(x, x, 'r');
+    board._OpenTiles(0, 0);
+    board.generate(x, point, seed);
+};
+
+static_assert(Board<Map>);
@@ -0,0 +1,152 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <array>
+
+#include "jobs.h"
+
+/**
+ *  текстурные координаты 4 вершин для каждой картинки атласа, считаются при компиляции
+	атлас квадратный, 4 картинки по 32 пикселя в ряд, картинок ровно столько, сколько значений у Type
+ */
+struct uv_t {
+    float x, y;
+};
+
+static constexpr auto AtlasUV = [] {
+    std::array<std::array<uv_t, 4>, (size_t) Type::RedBomb + 1> table{};
+    for (size_t id = 0; id != table.size(); id++) {
+        float x = (id % 4) * 32.f, y = (id / 4) * 32.f;
+        table[id] = {{{x, y}, {x + 32, y}, {x + 32, y + 32}, {x, y + 32}}};
+    }
+    return table;
+}();
+
+/**
+ * текстурные координаты 4 вершин квадрата
+ * @param id это id для отрисовки квадрата, показывает, какую точку у атласа с текстурами рисовать
+ */
+static void setTexture(sf::Vertex *quad, size_t id) {
+    auto &uv = AtlasUV[id];
+    for (size_t k = 0; k != 4; k++)
+        quad[k].texCoords = sf::Vector2f(uv[k].x, uv[k].y);
+}
+
+/**
+ * заполняет 4 вершины одного квадрата
+ */
+static void setQuad(sf::Vertex *quad, float x, float y, size_t id) {
+
+    /**
+     * расчёт местоположения на экране
+     */
+    quad[0].position = sf::Vector2f(x, y);
+    quad[1].position = sf::Vector2f(x + 32, y);
+    quad[2].position = sf::Vector2f(x + 32, y + 32);
+    quad[3].position = sf::Vector2f(x, y + 32);
+
+    setTexture(quad, id);
+}
+
+size_t tileId(const Map::Tile &tile) {
+
+    /**
+     * если тайл виден игроку, то просто ставим то, что там есть
+     */
+    if (DEBUG_MODE || tile.first == 'r')
+        return (size_t) tile.second;
+
+        /**
+         * если тут флаг, то говорим рисовать флаг
+         */
+    else if (tile.first == 'f')
+        return (size_t) Type::Flag;
+    else
+        /**
+         * иначе просто рисуем пустоту
+         */
+        return (size_t) Type::Unknown;
+}
+
+/**
+ *  строки [from, to): сначала картинки всей строки в маленький буфер, потом вершины одним проходом
+	так чтение карты и запись вершин не перемешиваются, а запись идёт подряд по памяти
+	блок, где ничего не открыто и нет флагов, заполняется пустотой без чтения клеток
+ *  @param positions писать ли положения, при перестройке той же карты они уже на месте
+ */
+static void buildRows(const Map &map, sf::VertexArray &region, float offset, size_t from, size_t to,
+                      bool positions) {
+    size_t edge_size = map.size();
+    std::vector<uint8_t> ids(edge_size);
+
+    for (size_t j = from; j != to; j++) {
+        for (size_t bx = 0; bx != map.blocks(); bx++) {
+            size_t begin = bx * Map::BlockSize;
+            size_t end = std::min(edge_size, begin + Map::BlockSize);
+
+            if (!DEBUG_MODE && map._BlockHidden(bx, j / Map::BlockSize))
+                std::fill(ids.begin() + begin, ids.begin() + end, (uint8_t) Type::Unknown);
+            else
+                for (size_t i = begin; i != end; i++)
+                    ids[i] = tileId(map.at(i, j));
+        }
+
+        sf::Vertex *row = &region[j * edge_size * 4];
+        if (positions)
+            for (size_t i = 0; i != edge_size; i++)
+                setQuad(row + i * 4, i * 32, offset + j * 32, ids[i]);
+        else
+            for (size_t i = 0; i != edge_size; i++)
+                setTexture(row + i * 4, ids[i]);
+    }
+}
+
+/**
+ * сколько строк отдавать одной задаче, меньше - пул тратит больше на раздачу, чем на работу
+ */
+static constexpr size_t MeshGrain = 64;
+
+void buildMesh(const Map &map, sf::VertexArray &region, float offset) {
+    /**
+     * меняем размер массива вершин для карты игры
+	    умножаем на 4, тк квадратная карта
+     */
+    region.resize(4 * map.size() * map.size());
+    buildRows(map, region, offset, 0, map.size(), true);
+}
+
+void buildMesh(const Map &map, sf::VertexArray &region, float offset, alone::JobSystem &jobs) {
+    region.resize(4 * map.size() * map.size());
+    jobs.parallelFor(0, map.size(), MeshGrain, [&](size_t from, size_t to) {
+        buildRows(map, region, offset, from, to, true);
+    });
+}
+
+void retextureMesh(const Map &map, sf::VertexArray &region, alone::JobSystem &jobs) {
+    jobs.parallelFor(0, map.size(), MeshGrain, [&](size_t from, size_t to) {
+        buildRows(map, region, 0, from, to, false);
+    });
+}
+
+void updateMesh(const Map &map, sf::VertexArray &region, const std::vector<size_t> &dirty) {
+    size_t edge_size = map.size();
+
+    /**
+     * меняются только текстурные координаты, положение квадрата остаётся прежним
+     */
+    for (size_t index: dirty)
+        setTexture(&region[index * 4], tileId(map.at(index % edge_size, index / edge_size)));
+}
+
+void setTile(sf::VertexArray &region, size_t index, size_t id) {
+    setTexture(&region[index * 4], id);
+}
+
+sf::Color lodColor(const LodPyramid::cell_t &cell) {
+    if (cell.exploded)
+        return sf::Color(255, 0, 0);
+    sf::Uint8 shade = 90 + cell.revealed * 110 / 255;
+    if (cell.flagged)
+        return sf::Color(shade, shade / 2, shade / 2);
+    return sf::Color(shade, shade, shade);
+}
@@ -0,0 +1,50 @@
+#pragma once
+//sfml
+#include <SFML/Graphics/VertexArray.hpp>
+#include <SFML/Graphics/Color.hpp>
+
+#include "map.h"
+#include "lod.h"
+
+/**
+ *  расчёт вершин для карты
+    вынесен из GameState, чтобы его можно было замерять отдельно от окна
+ *  @param offset смещение карты по вертикали под интерфейс
+ */
+void buildMesh(const Map &map, sf::VertexArray &region, float offset);
+
+/**
+ *  то же самое, но строки раздаются пулу, для огромных карт
+	картинки берутся из таблицы, посчитанной при компиляции
+ */
+void buildMesh(const Map &map, sf::VertexArray &region, float offset, alone::JobSystem &jobs);
+
+/**
+ *  полная перестройка только текстурных координат, положения вершин остаются с прошлого buildMesh
+	для случаев, когда меняется всё, но не размер: новая партия, смена темы, отмена многих ходов
+ */
+void retextureMesh(const Map &map, sf::VertexArray &region, alone::JobSystem &jobs);
+
+/**
+ *  обновление вершин только у изменившихся клеток, O(изменений), а не O(размера карты)
+    вершины уже должны быть построены buildMesh для карты того же размера
+ *  @param dirty индексы клеток x + y * size, обычно Map::dirty()
+ */
+void updateMesh(const Map &map, sf::VertexArray &region, const std::vector<size_t> &dirty);
+
+/**
+ * какую картинку атласа рисовать для клетки
+ */
+size_t tileId(const Map::Tile &tile);
+
+/**
+ *  меняет картинку одной клетки, когда картинка уже посчитана, например в потоке симуляции
+ *  @param index x + y * size
+ */
+void setTile(sf::VertexArray &region, size_t index, size_t id);
+
+/**
+ *  цвет квадрата пирамиды для карты издалека
+	закрытое темнее, открытое светлее, флаги в красноватом оттенке, взорванная бомба - ярко-красная
+ */
+sf::Color lodColor(const LodPyramid::cell_t &cell);
@@ -0,0 +1,96 @@
+#include "perf.h"
+
+#ifdef __linux__
+
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * тип и конфигурация perf для каждого счётчика из perf::Event
+ */
+static const std::array<std::pair<uint32_t, uint64_t>, perf::Count> events = {{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}
+}};
+
+perf::Counters::Counters() {
+    for (size_t i = 0; i != Count; i++) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].first;
+        attr.config = events[i].second;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        /**
+         * если счётчиков больше, чем регистров, ядро их чередует, тогда значения надо масштабировать
+         */
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        _Fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    }
+}
+
+perf::Counters::~Counters() {
+    for (int fd: _Fd)
+        if (fd >= 0)
+            close(fd);
+}
+
+bool perf::Counters::available() const {
+    for (int fd: _Fd)
+        if (fd >= 0)
+            return true;
+    return false;
+}
+
+void perf::Counters::start() {
+    for (int fd: _Fd) {
+        if (fd < 0)
+            continue;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void perf::Counters::stop(values_t &out) {
+    for (int fd: _Fd)
+        if (fd >= 0)
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+    for (size_t i = 0; i != Count; i++) {
+        uint64_t data[3];
+        if (_Fd[i] < 0 || read(_Fd[i], data, sizeof(data)) != sizeof(data) || data[2] == 0)
+            continue;
+        out[i] += data[1] == data[2] ? data[0] : (uint64_t) ((double) data[0] * data[1] / data[2]);
+    }
+}
+
+#else
+
+/**
+ * на других системах счётчиков нет, замеры идут только по времени
+ */
+perf::Counters::Counters() {
+    _Fd.fill(-1);
+}
+
+perf::Counters::~Counters() = default;
+
+bool perf::Counters::available() const {
+    return false;
+}
+
+void perf::Counters::start() {}
+
+void perf::Counters::stop(values_t &) {}
+
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+//std
+#include <array>
+#include <cstdint>
+
+/**
+ *  аппаратные счётчики процессора для замеров, на Linux через perf_event_open
+    в контейнерах и виртуалках счётчиков часто нет, тогда available() = false и остаётся только время
+ */
+namespace perf {
+
+    enum Event {
+        Cycles,
+        Instructions,
+        L1Misses,
+        LLCMisses,
+        BranchMisses,
+        Count
+    };
+
+    /**
+     * короткие имена для вывода
+     */
+    constexpr std::array<const char *, Count> Names = {"cycles", "instr", "L1d-miss", "LLC-miss", "br-miss"};
+
+    using values_t = std::array<uint64_t, Count>;
+
+    /**
+     *  каждый счётчик открывается отдельно, а не группой
+	    так если процессор не умеет, например, LLC, остальные всё равно работают
+     */
+    class Counters {
+    public:
+        Counters();
+
+        Counters(const Counters &) = delete;
+
+        Counters &operator=(const Counters &) = delete;
+
+        ~Counters();
+
+        /**
+         * есть ли хотя бы один счётчик
+         */
+        bool available() const;
+
+        /**
+         * открыт ли конкретный счётчик
+         */
+        bool has(Event event) const {
+            return _Fd[event] >= 0;
+        }
+
+        /**
+         * обнуляет и запускает все счётчики
+         */
+        void start();
+
+        /**
+         * останавливает счётчики и прибавляет их значения к out
+         */
+        void stop(values_t &out);
+
+    private:
+        std::array<int, Count> _Fd;
+    };
+}
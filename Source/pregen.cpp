@@ -0,0 +1,96 @@
+#include "pregen.h"
+
+#include <random>
+
+pregen::Worker::~Worker() {
+    stop();
+}
+
+void pregen::Worker::start() {
+    if (_Thread.joinable())
+        return;
+    _Stop = false;
+    _Thread = std::thread(&Worker::_Run, this);
+}
+
+void pregen::Worker::stop() {
+    {
+        std::lock_guard lock(_Mutex);
+        _Stop = true;
+    }
+    _Wake.notify_all();
+    if (_Thread.joinable())
+        _Thread.join();
+}
+
+bool pregen::Worker::take(size_t level, Ready &out) {
+    {
+        std::lock_guard lock(_Mutex);
+        auto &queue = _Queues[level];
+        if (queue.empty())
+            return false;
+
+        /**
+         * карта переезжает без копирования, под мьютексом только перестановка указателей
+         */
+        out = std::move(queue.front());
+        queue.pop_front();
+    }
+    _Wake.notify_all();
+    return true;
+}
+
+void pregen::Worker::recycle(Map map) {
+    std::lock_guard lock(_Mutex);
+    if (_Spare.size() < Depth)
+        _Spare.push_back(std::move(map));
+}
+
+size_t pregen::Worker::ready(size_t level) {
+    std::lock_guard lock(_Mutex);
+    return _Queues[level].size();
+}
+
+size_t pregen::Worker::_Hungriest() const {
+    size_t level = difficulties.size();
+    for (size_t i = 0; i != difficulties.size(); i++)
+        if (_Queues[i].size() < Depth && (level == difficulties.size() || _Queues[i].size() < _Queues[level].size()))
+            level = i;
+    return level;
+}
+
+void pregen::Worker::_Run() {
+    std::random_device rd;
+
+    while (true) {
+        size_t level;
+        Ready ready;
+        {
+            std::unique_lock lock(_Mutex);
+            _Wake.wait(lock, [this] {
+                return _Stop || _Hungriest() != difficulties.size();
+            });
+            if (_Stop)
+                return;
+            level = _Hungriest();
+
+            /**
+             * если есть возвращённая карта, resize переиспользует её память
+             */
+            if (!_Spare.empty()) {
+                ready.map = std::move(_Spare.back());
+                _Spare.pop_back();
+            }
+        }
+
+        /**
+         * генерация снаружи мьютекса, take в это время не ждёт
+         */
+        ready.seed = ((uint64_t) rd() << 32) | rd();
+        ready.map.resize(level);
+        ready.map.generate(difficulties[level].bombs, ready.seed);
+
+        std::lock_guard lock(_Mutex);
+        _Queues[level].push_back(std::move(ready));
+    }
+}
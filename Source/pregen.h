@@ -0,0 +1,91 @@
+#pragma once
+//std
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "map.h"
+
+/**
+ *  заготовка карт в фоне, пока игрок сидит в меню или на экране конца игры
+    на каждый уровень сложности держится маленькая очередь готовых карт
+    GameState забирает карту из очереди сразу, а сам генерирует только если очередь пуста
+ */
+namespace pregen {
+
+    /**
+     * сколько готовых карт держать на каждый уровень сложности
+     */
+    constexpr size_t Depth = 2;
+
+    /**
+     * готовая карта и зерно, с которым она генерировалась, зерно нужно повтору
+     */
+    struct Ready {
+        uint64_t seed = 0;
+        Map map;
+    };
+
+    /**
+     *  фоновый поток, который доливает очереди до Depth
+	    генерация идёт без блокировки, под мьютексом только перекладывание готовой карты
+     */
+    class Worker {
+    public:
+        Worker() = default;
+
+        Worker(const Worker &) = delete;
+
+        Worker &operator=(const Worker &) = delete;
+
+        ~Worker();
+
+        void start();
+
+        /**
+         * останавливает поток, недоделанная карта выбрасывается
+         */
+        void stop();
+
+        /**
+         *  забирает готовую карту, поток тут же начинает делать следующую
+         *  @return false, если очередь этого уровня пуста
+         */
+        bool take(size_t level, Ready &out);
+
+        /**
+         *  отдаёт потоку память старой карты, следующая заготовка генерируется в неё
+	        так партии подряд обходятся без выделений: карты только меняются местами
+         */
+        void recycle(Map map);
+
+        /**
+         * сколько карт сейчас готово для уровня
+         */
+        size_t ready(size_t level);
+
+    private:
+        void _Run();
+
+        /**
+         * уровень, где готовых карт меньше всего, или difficulties.size(), если все очереди полны
+         */
+        size_t _Hungriest() const;
+
+        std::thread _Thread;
+        std::mutex _Mutex;
+        std::condition_variable _Wake;
+        bool _Stop = false;
+
+        std::array<std::deque<Ready>, std::tuple_size_v<decltype(difficulties)>> _Queues;
+
+        /**
+         * карты, отданные через recycle, их не больше Depth
+         */
+        std::vector<Map> _Spare;
+    };
+}
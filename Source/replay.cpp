@@ -0,0 +1,137 @@
+#include "replay.h"
+#include "codec.h"
+
+#include <algorithm>
+#include <cstring>
+
+/**
+ * заголовок повтора, пишется как есть, little endian
+ */
+#pragma pack(push, 1)
+struct replay_header_t {
+    char magic[4] = {'S', 'A', 'P', 'L'};
+    uint16_t version = replay::Version;
+    uint16_t level = 0;
+    uint64_t seed = 0;
+    uint32_t x = 0, y = 0;
+};
+#pragma pack(pop)
+
+replay::Recorder::~Recorder() {
+    stop();
+}
+
+void replay::Recorder::start(const std::string &path, size_t level, uint64_t seed, sf::Vector2u first) {
+    stop();
+    _File.open(path, std::ios::binary | std::ios::trunc);
+    _Last = _Flushed = 0;
+
+    replay_header_t header;
+    header.level = level;
+    header.seed = seed;
+    header.x = first.x;
+    header.y = first.y;
+    _File.write((const char *) &header, sizeof(header));
+    _File.flush();
+}
+
+void replay::Recorder::append(const Event &event) {
+    if (!_File.is_open())
+        return;
+
+    codec::putVarint(_Buffer, event.time - std::min(event.time, _Last));
+    _Buffer.push_back((uint8_t) event.action);
+    codec::putVarint(_Buffer, event.x);
+    codec::putVarint(_Buffer, event.y);
+    _Last = event.time;
+
+    if (event.time - std::min(event.time, _Flushed) >= FlushInterval) {
+        _Flush();
+        _Flushed = event.time;
+    }
+}
+
+void replay::Recorder::stop() {
+    if (!_File.is_open())
+        return;
+    _Flush();
+    _File.close();
+}
+
+void replay::Recorder::_Flush() {
+    _File.write((const char *) _Buffer.data(), _Buffer.size());
+    _File.flush();
+    _Buffer.clear();
+}
+
+bool replay::read(const std::string &path, Replay &replay) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+
+    std::vector<uint8_t> data(file.tellg());
+    file.seekg(0);
+    if (!file.read((char *) data.data(), data.size()) || data.size() < sizeof(replay_header_t))
+        return false;
+
+    replay_header_t header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, replay_header_t().magic, 4) != 0 || header.version != Version ||
+        header.level >= difficulties.size())
+        return false;
+
+    /**
+     * точка первого нажатия и ходы идут прямо в карту без проверок, поэтому всё за её краем - порча файла
+     */
+    size_t size = difficulties[header.level].size;
+    if (header.x >= size || header.y >= size)
+        return false;
+
+    replay.level = header.level;
+    replay.seed = header.seed;
+    replay.first = sf::Vector2u(header.x, header.y);
+    replay.events.clear();
+
+    /**
+     * недописанный последний ход просто отбрасывается, как и всё начиная с хода за краем карты
+     */
+    const uint8_t *it = data.data() + sizeof(header), *end = data.data() + data.size();
+    uint64_t time = 0;
+    while (it != end) {
+        uint64_t delta, x, y;
+        if (!codec::getVarint(it, end, delta) || it == end)
+            break;
+        uint8_t action = *it++;
+        if (action > (uint8_t) Action::Chord || !codec::getVarint(it, end, x) || !codec::getVarint(it, end, y) ||
+            x >= size || y >= size)
+            break;
+        time += delta;
+        replay.events.push_back({(uint32_t) time, (Action) action, (uint32_t) x, (uint32_t) y});
+    }
+    return true;
+}
+
+size_t replay::play(const Replay &replay, Map &map) {
+    auto &d = difficulties[replay.level];
+    if (map.size() != d.size)
+        map.resize(d.size, map.layout());
+    map.generate(d.bombs, replay.seed);
+    map.makeSafe(replay.first, replay.seed + 1);
+
+    size_t applied = 0;
+    for (auto &event: replay.events) {
+        if (event.x >= map.size() || event.y >= map.size())
+            break;
+        applied++;
+
+        if (event.action == Action::Left) {
+            if (map.reveal(event.x, event.y))
+                break;
+        } else if (event.action == Action::Chord) {
+            if (map.chord(event.x, event.y))
+                break;
+        } else
+            map.toggleFlag(event.x, event.y);
+    }
+    return applied;
+}
@@ -0,0 +1,117 @@
+#pragma once
+//std
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "map.h"
+
+/**
+ *  запись партии для повтора
+    файл - заголовок (уровень, зерно генерации, первое нажатие) и дальше только дописываемые ходы
+    ход - varint'ы: сколько миллисекунд прошло с прошлого хода, действие, x, y
+    карта из зерна всегда одна и та же, поэтому по записи партия восстанавливается целиком
+ */
+namespace replay {
+
+    /**
+     * версия 1 генерировала карту в момент первого нажатия, сейчас карта готова заранее
+     */
+    constexpr uint16_t Version = 2;
+
+    /**
+     * куда пишется последняя сыгранная партия
+     */
+    const std::string Path = "last.replay";
+
+    /**
+     * действия игрока
+     */
+    enum class Action : uint8_t {
+        Left,
+        Right,
+
+        /**
+         * аккорд по открытому числу, средняя кнопка или обе сразу
+         */
+        Chord
+    };
+
+    /**
+     * один ход
+     */
+    struct Event {
+        /**
+         * миллисекунды с начала игры
+         */
+        uint32_t time;
+        Action action;
+        uint32_t x, y;
+    };
+
+    /**
+     * вся партия целиком
+     */
+    struct Replay {
+        size_t level = 0;
+        uint64_t seed = 0;
+        sf::Vector2u first;
+        std::vector<Event> events;
+    };
+
+    /**
+     *  запись партии в файл по мере игры
+	    ходы дописываются в конец пачками (см. FlushInterval), так что при вылете остаётся всё, кроме последней пачки
+     */
+    class Recorder {
+    public:
+        /**
+         *  ходы копятся в памяти и уходят в файл раз в FlushInterval миллисекунд игры или в stop
+	        так ход не стоит системного вызова, а при падении теряются только ходы после последнего сброса
+         */
+        static constexpr uint32_t FlushInterval = 1000;
+
+        Recorder() = default;
+
+        Recorder(const Recorder &) = delete;
+
+        Recorder &operator=(const Recorder &) = delete;
+
+        ~Recorder();
+
+        /**
+         * начинает новую запись, старый файл затирается, прошлая запись перед этим дописывается
+         */
+        void start(const std::string &path, size_t level, uint64_t seed, sf::Vector2u first);
+
+        /**
+         * дописывает ход, если запись не начата, то ничего не делает
+         */
+        void append(const Event &event);
+
+        /**
+         * дописывает накопленные ходы и закрывает файл
+         */
+        void stop();
+
+    private:
+        void _Flush();
+
+        std::ofstream _File;
+        std::vector<uint8_t> _Buffer;
+        uint32_t _Last = 0, _Flushed = 0;
+    };
+
+    /**
+     * @return false, если файла нет или это не повтор
+     */
+    bool read(const std::string &path, Replay &replay);
+
+    /**
+     *  восстанавливает партию без отрисовки, как можно быстрее
+	    ходы применяются так же, как в GameState, до первой бомбы
+     *  @return количество применённых ходов
+     */
+    size_t play(const Replay &replay, Map &map);
+}
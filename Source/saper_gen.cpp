@@ -0,0 +1,137 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "corpus.h"
+#include "jobs.h"
+
+/**
+ *  saper_gen - массовая генерация карт в двоичный набор
+    карты режутся на куски, пул раздаёт их потокам, каждый кусок сам пишет себя в свою часть файла
+    индекс пишется заранее, место каждой карты известно, поэтому блокировки не нужны
+
+    saper_gen -o boards.bin --count 1000000 --size 8 --mines 10 [--density 0.15]
+              [--seed 1] [--threads 16] [--first-click] [--with-seed]
+ */
+
+static void usage() {
+    std::cerr << "usage: saper_gen -o <file> --count <n> --size <edge> (--mines <n> | --density <0..1>)\n"
+                 "                 [--seed <n>] [--threads <n>] [--first-click] [--with-seed]\n";
+}
+
+/**
+ *  генерация карт [begin, end) и запись их в файл
+ *  @return false, если записать не удалось (например, кончилось место на диске)
+ */
+static bool work(const std::string &path, const corpus::Header &header, uint64_t begin, uint64_t end) {
+    std::ofstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file)
+        return false;
+    size_t record = corpus::recordSize(header);
+    file.seekp(corpus::recordOffset(header, begin));
+
+    /**
+     * пишем пачками примерно по мегабайту
+     */
+    size_t batch = std::max<size_t>(1, (1 << 20) / record);
+    std::vector<uint8_t> buffer(batch * record);
+
+    Map map;
+    map.resize(header.size, Map::Layout::RowMajor);
+
+    for (uint64_t i = begin; i < end; i += batch) {
+        size_t n = std::min<uint64_t>(batch, end - i);
+        for (size_t k = 0; k != n; k++) {
+            uint64_t seed;
+            auto first = corpus::generate(map, header, i + k, seed);
+            corpus::encode(header, map, first, seed, buffer.data() + k * record);
+        }
+        if (!file.write((const char *) buffer.data(), n * record))
+            return false;
+    }
+
+    /**
+     * последняя пачка может лечь на диск только при закрытии, её ошибку тоже надо поймать
+     */
+    file.close();
+    return !file.fail();
+}
+
+int main(int argc, char **argv) {
+    corpus::Header header;
+    std::string path;
+    double density = -1;
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool value = i + 1 < argc;
+
+        if (arg == "-o" && value)
+            path = argv[++i];
+        else if (arg == "--count" && value)
+            header.count = std::stoull(argv[++i]);
+        else if (arg == "--size" && value)
+            header.size = std::stoul(argv[++i]);
+        else if (arg == "--mines" && value)
+            header.bombs = std::stoul(argv[++i]);
+        else if (arg == "--density" && value)
+            density = std::stod(argv[++i]);
+        else if (arg == "--seed" && value)
+            header.seed = std::stoull(argv[++i]);
+        else if (arg == "--threads" && value)
+            threads = std::max(1ul, std::stoul(argv[++i]));
+        else if (arg == "--first-click")
+            header.flags |= corpus::FirstClick;
+        else if (arg == "--with-seed")
+            header.flags |= corpus::Seed;
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (density >= 0)
+        header.bombs = density * header.size * header.size;
+
+    if (path.empty() || header.size == 0 || header.bombs >= (size_t) header.size * header.size) {
+        usage();
+        return 1;
+    }
+
+    /**
+     * заголовок, индекс и место под все записи, дальше потоки пишут каждый в свою часть
+     */
+    if (!corpus::create(path, header)) {
+        std::cerr << "saper_gen: cannot create " << path << '\n';
+        return 1;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+
+    /**
+     *  кусков в несколько раз больше, чем потоков, чтобы быстрые потоки забирали работу у медленных
+	    вызывающий поток тоже работает, поэтому рабочих на один меньше
+     */
+    alone::JobSystem jobs(threads - 1);
+    uint64_t chunk = std::max<uint64_t>(1, (header.count + threads * 4 - 1) / (threads * 4));
+    std::atomic<bool> failed = false;
+    jobs.parallelFor(0, header.count, chunk, [&](size_t from, size_t to) {
+        if (!failed.load(std::memory_order_relaxed) && !work(path, header, from, to))
+            failed.store(true, std::memory_order_relaxed);
+    });
+
+    if (failed) {
+        std::cerr << "saper_gen: cannot write " << path << '\n';
+        return 1;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    std::cout << header.count << " boards in " << elapsed.count() << " s ("
+              << header.count / elapsed.count() << " boards/s, " << threads << " threads)\n";
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "save.h"
+#include "codec.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+/**
+ * заголовок файла сохранения, пишется как есть, little endian
+ */
+#pragma pack(push, 1)
+struct save_header_t {
+    char magic[4] = {'S', 'A', 'P', 'S'};
+    uint16_t version = save::Version;
+    uint16_t level = 0;
+    uint64_t revealed = 0;
+    uint64_t remained = 0;
+    int64_t elapsed = 0;
+};
+#pragma pack(pop)
+
+void save::encode(const Progress &progress, const Map &map, std::vector<uint8_t> &out) {
+    save_header_t header;
+    header.level = progress.level;
+    header.revealed = progress.revealed;
+    header.remained = progress.remained;
+    header.elapsed = progress.elapsed;
+
+    size_t begin = out.size();
+    out.resize(begin + sizeof(header));
+    std::memcpy(out.data() + begin, &header, sizeof(header));
+    codec::encode(map, out);
+}
+
+bool save::write(const std::string &path, const Snapshot &snapshot) {
+    /**
+     * сначала собираем всё в память, чтобы записать одним вызовом
+     */
+    std::vector<uint8_t> data;
+    encode(snapshot, snapshot.map, data);
+    return write(path, data);
+}
+
+bool save::write(const std::string &path, const std::vector<uint8_t> &data) {
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        file.write((const char *) data.data(), data.size());
+        file.flush();
+        if (!file)
+            return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp, path, error);
+    return !error;
+}
+
+bool save::read(const std::string &path, Snapshot &snapshot) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+
+    std::vector<uint8_t> data(file.tellg());
+    file.seekg(0);
+    if (!file.read((char *) data.data(), data.size()) || data.size() < sizeof(save_header_t))
+        return false;
+
+    save_header_t header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, save_header_t().magic, 4) != 0 || header.version != Version ||
+        header.level >= difficulties.size())
+        return false;
+
+    const uint8_t *it = data.data() + sizeof(header);
+    if (!codec::decode(it, data.data() + data.size(), snapshot.map))
+        return false;
+
+    snapshot.level = header.level;
+    snapshot.revealed = header.revealed;
+    snapshot.remained = header.remained;
+    snapshot.elapsed = header.elapsed;
+    return true;
+}
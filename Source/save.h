@@ -0,0 +1,72 @@
+#pragma once
+//std
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "map.h"
+
+/**
+ *  сохранение незаконченной игры
+    файл - это заголовок фиксированного размера и дальше карта в формате codec
+    пишется во временный файл и потом переименовывается, так что оборванная запись не портит старое сохранение
+ */
+namespace save {
+
+    /**
+     *  версия формата, при несовпадении сохранение не загружается
+	    2 - убран счётчик правильных флагов, карта после загрузки считает его сама
+     */
+    constexpr uint16_t Version = 2;
+
+    /**
+     * куда сохраняется игра по умолчанию
+     */
+    const std::string Path = "save.dat";
+
+    /**
+     * всё, что нужно, чтобы продолжить игру с того же места, кроме самой карты
+     */
+    struct Progress {
+        size_t level = 0;
+
+        /**
+         * количество открытых клеток
+         */
+        size_t revealed = 0;
+
+        /**
+         * счётчик оставшихся бомб, который видит игрок
+         */
+        size_t remained = 0;
+
+        /**
+         * сколько времени уже прошло с начала игры
+         */
+        int64_t elapsed = 0;
+    };
+
+    struct Snapshot : Progress {
+        Map map;
+    };
+
+    /**
+     *  всё содержимое файла сохранения в out, карта не копируется, а сразу кодируется
+	    так игра в главном потоке платит только за кодирование, а в фон уходят готовые байты
+     */
+    void encode(const Progress &progress, const Map &map, std::vector<uint8_t> &out);
+
+    /**
+     *  записывает готовые байты из encode
+     *  @return false, если не получилось записать, старое сохранение тогда остаётся
+     */
+    bool write(const std::string &path, const std::vector<uint8_t> &data);
+
+    bool write(const std::string &path, const Snapshot &snapshot);
+
+    /**
+     *  весь файл читается одним вызовом, потом разбирается из памяти
+     *  @return false, если файла нет, он испорчен или другой версии
+     */
+    bool read(const std::string &path, Snapshot &snapshot);
+}
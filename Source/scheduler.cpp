@@ -0,0 +1,82 @@
+#include "scheduler.h"
+
+#include <algorithm>
+
+void alone::FrameScheduler::beginFrame() {
+    _Begin = _Mark = clock::now();
+    _Phases.fill(clock::duration::zero());
+}
+
+void alone::FrameScheduler::lap(Phase phase) {
+    auto now = clock::now();
+    _Phases[(size_t) phase] += now - _Mark;
+    _Mark = now;
+}
+
+void alone::FrameScheduler::post(Priority priority, task_t task) {
+    _Push({_Frame + (uint64_t) priority * AgeFrames, _Order++, _Frame, std::move(task)});
+}
+
+void alone::FrameScheduler::_Push(entry_t entry) {
+    _Tasks.push_back(std::move(entry));
+    std::push_heap(_Tasks.begin(), _Tasks.end(), std::greater<>());
+}
+
+size_t alone::FrameScheduler::runIdle() {
+    auto deadline = _Begin + _Budget - Reserve;
+    size_t ran = 0, forced = 0, longest = 0;
+
+    while (!_Tasks.empty()) {
+
+        /**
+         * без остатка бюджета выполняется только одна задача, которая ждёт слишком долго
+         */
+        bool spare = clock::now() < deadline;
+        bool starving = _Frame - _Tasks.front().frame >= MaxWait;
+        if (!spare && (!starving || forced != 0))
+            break;
+
+        std::pop_heap(_Tasks.begin(), _Tasks.end(), std::greater<>());
+        entry_t entry = std::move(_Tasks.back());
+        _Tasks.pop_back();
+
+        size_t waited = _Frame - entry.frame;
+        if (!entry.task()) {
+            _Deferred.push_back(std::move(entry));
+            continue;
+        }
+        ran++;
+        forced += !spare;
+        longest = std::max(longest, waited);
+    }
+
+    /**
+     * отложенные возвращаются в очередь со старым ключом, так что продолжают стареть
+     */
+    size_t deferred = _Deferred.size();
+    for (auto &entry: _Deferred)
+        _Push(std::move(entry));
+    _Deferred.clear();
+    lap(Phase::Idle);
+
+    /**
+     * статистика кадра, среднее - экспоненциальное, чтобы цифры на экране не прыгали
+     */
+    using ms = std::chrono::duration<double, std::milli>;
+    for (size_t i = 0; i != _Phases.size(); i++) {
+        _Stats.last[i] = ms(_Phases[i]).count();
+        _Stats.average[i] = _Stats.frames ? _Stats.average[i] * 0.9 + _Stats.last[i] * 0.1 : _Stats.last[i];
+    }
+    _Stats.budget = ms(_Budget).count();
+    _Stats.frame = ms(_Mark - _Begin).count();
+    _Stats.ran = ran;
+    _Stats.forced = forced;
+    _Stats.deferred = deferred;
+    _Stats.pending = _Tasks.size();
+    _Stats.longestWait = longest;
+    _Stats.overBudget += _Mark - _Begin > _Budget;
+    _Stats.frames++;
+
+    _Frame++;
+    return ran;
+}
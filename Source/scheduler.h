@@ -0,0 +1,139 @@
+#pragma once
+//std
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace alone {
+
+    /**
+     *  бюджет кадра главного цикла
+	    цикл отмечает, сколько ушло на ввод, обновление и отрисовку, а остаток до следующего кадра
+	    отдаётся отложенным задачам (автосохранение, миникарта и т.п.), которым не обязательно успеть в этот кадр
+	    у задач есть приоритет, а ждущие задачи стареют: каждые AgeFrames кадров ожидания - на приоритет выше
+	    задача, прождавшая MaxWait кадров, выполняется даже без остатка бюджета, одна за кадр, так что никто не голодает
+     */
+    class FrameScheduler {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        /**
+         * на что ушло время кадра, Idle - отложенные задачи
+         */
+        enum class Phase {
+            Input,
+            Update,
+            Draw,
+            Idle,
+            Count
+        };
+
+        enum class Priority {
+            High,
+            Normal,
+            Low
+        };
+
+        /**
+         *  задача возвращает false, если сейчас ей работать нельзя (например, карта занята)
+	        тогда она остаётся в очереди со своим возрастом и в этом кадре больше не вызывается
+         */
+        using task_t = std::function<bool()>;
+
+        static constexpr size_t AgeFrames = 30;
+        static constexpr size_t MaxWait = 120;
+
+        /**
+         * запас на display и драйвер, его задачи не занимают
+         */
+        static constexpr std::chrono::microseconds Reserve{2000};
+
+        /**
+         * статистика последнего кадра и сглаженная за несколько, время в миллисекундах
+         */
+        struct stats_t {
+            std::array<double, (size_t) Phase::Count> last{}, average{};
+            double budget = 0;
+            double frame = 0;
+            size_t ran = 0;
+            size_t forced = 0;
+            size_t deferred = 0;
+            size_t pending = 0;
+            size_t longestWait = 0;
+            uint64_t frames = 0;
+            uint64_t overBudget = 0;
+        };
+
+        /**
+         * @param budget длительность кадра, по умолчанию 60 кадров в секунду
+         */
+        explicit FrameScheduler(clock::duration budget = std::chrono::microseconds(16667)) : _Budget(budget) {}
+
+        void setBudget(clock::duration budget) {
+            _Budget = budget;
+        }
+
+        clock::duration budget() const {
+            return _Budget;
+        }
+
+        /**
+         * начало кадра, время до первого lap идёт в первую фазу, которую отметят
+         */
+        void beginFrame();
+
+        /**
+         * время с прошлой отметки прибавляется к фазе, за кадр фазу можно отмечать сколько угодно раз
+         */
+        void lap(Phase phase);
+
+        void post(Priority priority, task_t task);
+
+        /**
+         *  выполняет задачи по старшинству, пока остаток бюджета больше Reserve, и закрывает кадр
+         *  @return сколько задач выполнилось
+         */
+        size_t runIdle();
+
+        size_t pending() const {
+            return _Tasks.size();
+        }
+
+        const stats_t &stats() const {
+            return _Stats;
+        }
+
+    private:
+        struct entry_t {
+            /**
+             *  приоритет с учётом возраста считается один раз при постановке: кадр постановки плюс AgeFrames за уровень
+	            задача с меньшим ключом важнее, при равенстве - та, что поставлена раньше
+             */
+            uint64_t key;
+            uint64_t order;
+            uint64_t frame;
+            task_t task;
+
+            bool operator>(const entry_t &other) const {
+                return key != other.key ? key > other.key : order > other.order;
+            }
+        };
+
+        void _Push(entry_t entry);
+
+        clock::duration _Budget;
+        clock::time_point _Begin, _Mark;
+        std::array<clock::duration, (size_t) Phase::Count> _Phases{};
+
+        /**
+         * куча по ключу, наверху самая важная задача
+         */
+        std::vector<entry_t> _Tasks;
+        std::vector<entry_t> _Deferred;
+        uint64_t _Frame = 0, _Order = 0;
+        stats_t _Stats;
+    };
+}
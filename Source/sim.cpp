@@ -0,0 +1,103 @@
+#include "sim.h"
+#include "mesh.h"
+
+sim::Thread::~Thread() {
+    stop();
+}
+
+void sim::Thread::start(Map &map, apply_t apply, step_t step) {
+    if (running())
+        return;
+    _Map = &map;
+    _Apply = std::move(apply);
+    _Step = std::move(step);
+    _Stop = _Working = false;
+    _Pushed = _Applied = 0;
+
+    /**
+     * остатки от прошлого запуска никому не нужны
+     */
+    Move move;
+    while (_Moves.pop(move));
+    Tile tile;
+    while (_Tiles.pop(tile));
+
+    _Thread = std::thread(&Thread::_Run, this);
+}
+
+void sim::Thread::stop() {
+    if (!running())
+        return;
+    _Stop = true;
+    _Pushed++;
+    _Pushed.notify_one();
+    _Thread.join();
+}
+
+void sim::Thread::push(const Move &move) {
+    while (!_Moves.push(move))
+        std::this_thread::yield();
+    _Pushed.fetch_add(1, std::memory_order_release);
+    _Pushed.notify_one();
+}
+
+void sim::Thread::drain(std::vector<Tile> &out) {
+    out.clear();
+    Tile tile;
+    for (size_t i = 0; i != 1 << 18 && _Tiles.pop(tile); i++)
+        out.push_back(tile);
+}
+
+bool sim::Thread::idle() const {
+    return _Applied.load(std::memory_order_acquire) == _Pushed.load(std::memory_order_relaxed) &&
+           !_Working.load(std::memory_order_acquire) && _Tiles.empty();
+}
+
+void sim::Thread::_Send(const Tile &tile) {
+    while (!_Tiles.push(tile) && !_Stop)
+        std::this_thread::yield();
+}
+
+void sim::Thread::_Publish(const Frame &frame) {
+    /**
+     *  изменившиеся клетки уходят сразу с картинкой, главному потоку не надо заглядывать в карту
+	    если перестроить надо всё, то это сделает главный поток, когда симуляция освободится
+     */
+    auto &map = *_Map;
+    if (!map.allDirty()) {
+        for (size_t index: map.dirty())
+            _Send({(uint32_t) index, (uint8_t) tileId(map.at(index % map.size(), index / map.size()))});
+        map.clearDirty();
+    }
+    _Frame.publish(frame);
+}
+
+void sim::Thread::_Run() {
+    uint64_t applied = 0;
+    bool working = false;
+    while (true) {
+        if (!working)
+            _Pushed.wait(applied, std::memory_order_acquire);
+        if (_Stop)
+            return;
+
+        /**
+         *  ходы идут первыми, а начатая работа продолжается кусками между ними
+	        так клик по уже открытой клетке не ждёт, пока большая заливка дойдёт до конца
+         */
+        Move move;
+        Frame frame;
+        if (_Moves.pop(move)) {
+            frame = _Apply(move);
+            applied++;
+        } else if (working)
+            frame = _Step();
+        else
+            continue;
+
+        _Publish(frame);
+        working = frame.working;
+        _Working.store(working, std::memory_order_release);
+        _Applied.store(applied, std::memory_order_release);
+    }
+}
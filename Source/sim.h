@@ -0,0 +1,140 @@
+#pragma once
+//std
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "map.h"
+#include "replay.h"
+#include "spsc.h"
+
+/**
+ *  правила игры в отдельном потоке симуляции
+	главный поток только собирает ввод и рисует, ходы уходят в симуляцию через очередь без блокировок
+	обратно приходят изменившиеся клетки и маленький кадр со счётчиками, так что большая заливка
+	не задерживает кадр, а рисует себя по частям по мере того, как клетки приходят
+	пока симуляция занята, главный поток не трогает карту, когда она свободна (idle) - можно всё, как раньше
+ */
+namespace sim {
+
+    /**
+     * ход игрока, время в миллисекундах от начала партии, как в повторе
+     */
+    struct Move {
+        replay::Action action;
+        uint32_t x, y;
+        uint32_t time;
+    };
+
+    /**
+     * изменившаяся клетка: index = x + y * size и картинка атласа
+     */
+    struct Tile {
+        uint32_t index;
+        uint8_t id;
+    };
+
+    /**
+     * то, что главному потоку надо знать после хода, кроме клеток
+     */
+    struct Frame {
+        size_t bombs = 0;
+        char status = 'a';
+
+        /**
+         * на карте ещё идёт заливка, симуляция продолжит её шагами между ходами
+         */
+        bool working = false;
+    };
+
+    class Thread {
+    public:
+        /**
+         * применяет ход к карте в потоке симуляции и возвращает кадр после него
+         */
+        using apply_t = std::function<Frame(const Move &)>;
+
+        /**
+         * один кусок начатой работы, пока кадр говорит working, вызывается снова
+         */
+        using step_t = std::function<Frame()>;
+
+        Thread() = default;
+
+        Thread(const Thread &) = delete;
+
+        Thread &operator=(const Thread &) = delete;
+
+        ~Thread();
+
+        void start(Map &map, apply_t apply, step_t step);
+
+        /**
+         * дожидается текущего хода и останавливает поток, необработанные ходы выбрасываются
+         */
+        void stop();
+
+        bool running() const {
+            return _Thread.joinable();
+        }
+
+        /**
+         * из главного потока, если очередь ходов полна, ждёт места
+         */
+        void push(const Move &move);
+
+        /**
+         *  из главного потока: забирает пришедшие клетки, но не больше одной очереди за раз,
+	        чтобы заливка на всю карту не превратила кадр в одну длинную выгрузку
+         */
+        void drain(std::vector<Tile> &out);
+
+        /**
+         * из главного потока: последний кадр, false - нового не было
+         */
+        bool frame(Frame &out) {
+            return _Frame.read(out);
+        }
+
+        /**
+         *  все отправленные ходы применены, работа после них доделана и все клетки забраны
+	        после этого главный поток видит карту целиком и может читать и менять её до следующего push
+         */
+        bool idle() const;
+
+    private:
+        void _Run();
+
+        /**
+         * отправка клетки, если очередь полна, ждёт, пока главный поток заберёт
+         */
+        void _Send(const Tile &tile);
+
+        /**
+         * отправка изменившихся клеток и кадра после хода или куска работы
+         */
+        void _Publish(const Frame &frame);
+
+        Map *_Map = nullptr;
+        apply_t _Apply;
+        step_t _Step;
+
+        alone::SpscQueue<Move, 256> _Moves;
+        alone::SpscQueue<Tile, 1 << 18> _Tiles;
+        alone::Latest<Frame> _Frame;
+
+        /**
+         * поток симуляции спит на _Pushed, пока он равен количеству применённых ходов
+         */
+        std::atomic<uint64_t> _Pushed = 0, _Applied = 0;
+
+        /**
+         * последний кадр был working, пишется до _Applied
+         */
+        std::atomic<bool> _Working = false;
+        std::atomic<bool> _Stop = false;
+        std::thread _Thread;
+    };
+}
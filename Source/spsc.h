@@ -0,0 +1,110 @@
+#pragma once
+//std
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace alone {
+
+    /**
+     *  очередь без блокировок для одного писателя и одного читателя
+	    кольцевой буфер, голова и хвост на разных линиях кэша, чтобы потоки не дёргали одну и ту же
+	    каждая сторона помнит последнее виденное положение другой и перечитывает его, только когда упёрлась
+     */
+    template<class T, size_t Capacity>
+    class SpscQueue {
+        static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+    public:
+        /**
+         * только из потока писателя, false - очередь полна
+         */
+        bool push(const T &value) {
+            size_t tail = _Tail.load(std::memory_order_relaxed);
+            if (tail - _HeadSeen == Capacity) {
+                _HeadSeen = _Head.load(std::memory_order_acquire);
+                if (tail - _HeadSeen == Capacity)
+                    return false;
+            }
+            _Items[tail & (Capacity - 1)] = value;
+            _Tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * только из потока читателя, false - очередь пуста
+         */
+        bool pop(T &out) {
+            size_t head = _Head.load(std::memory_order_relaxed);
+            if (head == _TailSeen) {
+                _TailSeen = _Tail.load(std::memory_order_acquire);
+                if (head == _TailSeen)
+                    return false;
+            }
+            out = _Items[head & (Capacity - 1)];
+            _Head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * точный ответ только в потоке читателя, из писателя - на какой-то момент в прошлом
+         */
+        bool empty() const {
+            return _Head.load(std::memory_order_acquire) == _Tail.load(std::memory_order_acquire);
+        }
+
+    private:
+        alignas(64) std::atomic<size_t> _Head = 0;
+        size_t _TailSeen = 0;
+
+        alignas(64) std::atomic<size_t> _Tail = 0;
+        size_t _HeadSeen = 0;
+
+        /**
+         * буфер в куче, очередь на сотни тысяч элементов не должна лежать на стеке
+         */
+        alignas(64) std::unique_ptr<T[]> _Items = std::make_unique<T[]>(Capacity);
+    };
+
+    /**
+     *  последнее значение от одного писателя для одного читателя, без блокировок
+	    двойной буфер плюс запасной: писатель всегда пишет в свободный, читатель забирает последний готовый
+	    так ни одна сторона не ждёт другую, а читатель никогда не видит наполовину записанное значение
+     */
+    template<class T>
+    class Latest {
+    public:
+        /**
+         * только из потока писателя
+         */
+        void publish(const T &value) {
+            _Buffers[_Back] = value;
+            size_t old = _Middle.exchange(_Back | Fresh, std::memory_order_acq_rel);
+            _Back = old & ~Fresh;
+        }
+
+        /**
+         *  только из потока читателя
+         *  @return false, если с прошлого вызова ничего нового не было, out тогда не меняется
+         */
+        bool read(T &out) {
+            if (!(_Middle.load(std::memory_order_relaxed) & Fresh))
+                return false;
+            size_t old = _Middle.exchange(_Front, std::memory_order_acq_rel);
+            _Front = old & ~Fresh;
+            out = _Buffers[_Front];
+            return true;
+        }
+
+    private:
+        /**
+         * бит "в среднем буфере новое значение" рядом с его номером, чтобы менять их одной операцией
+         */
+        static constexpr size_t Fresh = 4;
+
+        std::array<T, 3> _Buffers{};
+        size_t _Back = 0, _Front = 1;
+        std::atomic<size_t> _Middle = 2;
+    };
+}
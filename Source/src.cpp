@@ -1,10 +1,5 @@
 #include "src.h"
 
-/**
- * набор уровней сложности, свой выдавать нельзя
- */
-std::array<difficulty_t, 3> difficulties;
-
 /**
  * менеджер текстур, это просто инициализация
  */
@@ -24,6 +19,25 @@ sf::Font font;
 
 LRMB lrmb;
 
+Keys keys;
+
+Wheel mouseWheel;
+
+/**
+ * фоновая заготовка карт, запускается в init
+ */
+pregen::Worker boards;
+
+/**
+ * бюджет кадра и отложенные задачи, кадр отмечает главный цикл
+ */
+alone::FrameScheduler frames;
+
+/**
+ * F3 - время кадра и очередь отложенных задач
+ */
+alone::PerfOverlay overlay;
+
 /**
  * контейнер для управления текстурами
  */
@@ -70,6 +84,21 @@ void alone::StateMachine::erase(std::string key) {
         it->second->_Status = State::OnDelete;
 }
 
+/**
+ * при закрытии окна состояния уже не обновятся, поэтому даём им шанс сохраниться
+ */
+void alone::StateMachine::close() {
+    for (auto &it: _Content)
+        if (it.second->_Status == State::Active)
+            it.second->onClose();
+}
+
+void alone::StateMachine::resize(sf::Vector2u size) {
+    for (auto &it: _Content)
+        if (it.second->_Status == State::Active)
+            it.second->onResize(size);
+}
+
 void alone::StateMachine::update() {
     /**
      *  была проблема с контейнером, нельзя во время иттерации элементы удалять
@@ -80,7 +109,22 @@ void alone::StateMachine::update() {
         switch (it.second->_Status) {
             case State::OnCreate:
                 it.second->onCreate();
-                it.second->_Status = State::Active;
+                it.second->_Loading = it.second->onLoad();
+                it.second->_Status = it.second->_Loading.done() ? State::Active : State::Loading;
+                frames.lap(FrameScheduler::Phase::Update);
+                break;
+
+                /**
+                 * onLoad продолжается, когда готово то, чего она ждёт, до этого рисуется экран загрузки
+                 */
+            case State::Loading:
+                if (it.second->_Loading.resume()) {
+                    it.second->_Loading = Coroutine();
+                    it.second->_Status = State::Active;
+                }
+                frames.lap(FrameScheduler::Phase::Update);
+                it.second->drawLoading(window, sf::RenderStates::Default);
+                frames.lap(FrameScheduler::Phase::Draw);
                 break;
 
                 /**
@@ -88,13 +132,20 @@ void alone::StateMachine::update() {
                  */
             case State::Active:
                 it.second->update();
+                frames.lap(FrameScheduler::Phase::Update);
                 it.second->draw(window, sf::RenderStates::Default);
+                frames.lap(FrameScheduler::Phase::Draw);
                 break;
 
 
+                /**
+                 * недоделанная загрузка выбрасывается раньше onDelete, её фоновая работа при этом дожидается
+                 */
             case State::OnDelete:
+                it.second->_Loading = Coroutine();
                 it.second->onDelete();
                 onRemove.push(it.first);
+                frames.lap(FrameScheduler::Phase::Update);
                 break;
         }
     }
@@ -107,198 +158,123 @@ void alone::StateMachine::update() {
     }
 }
 
-/**
- * работа с кнопками
- */
-void alone::input::update() {
-    lrmb.preLmb = lrmb.nowLmb;
-    lrmb.preRmb = lrmb.nowRmb;
-    lrmb.nowLmb = sf::Mouse::isButtonPressed(sf::Mouse::Left);
-    lrmb.nowRmb = sf::Mouse::isButtonPressed(sf::Mouse::Right);
-}
-
-/**
- * для левой кнопки мыши
- * @return выдаёт true только если кнопка была только что поднята
- */
-bool alone::input::isClickedLeftButton() {
-    return lrmb.preLmb && !lrmb.nowLmb;
-}
-
-/**
- * для правой
- */
-bool alone::input::isClickedRightButton() {
-    return lrmb.preRmb && !lrmb.nowRmb;
-}
-
-/**
- * Работа с картой
- */
-void Map::resize(size_t level) {
-    /**
-     * собственно и взятие уровня сложности
-     */
-    auto &d = difficulties[level];
+void alone::PerfOverlay::update(const FrameScheduler::stats_t &stats) {
+    if (alone::input::isClickedKey(sf::Keyboard::F3))
+        _Visible = !_Visible;
+    if (!_Visible || (_Refresh.getElapsedTime() < sf::seconds(0.25f) && !_Text.getString().isEmpty()))
+        return;
+    _Refresh.restart();
 
     /**
-     * изменение ширины поля карты
+     * средние за последние кадры, иначе цифры не прочитать
      */
-    _Content.resize(d.size);
-    for (auto &it: _Content)
-        /**
-         * изменение высота поля, для каждой колонки в отдельности
-         */
-        it.resize(d.size, {'n', Type::None});
+    auto ms = [](double value) {
+        char text[16];
+        std::snprintf(text, sizeof(text), "%.2f", value);
+        return std::string(text);
+    };
+    using Phase = FrameScheduler::Phase;
+    std::string text = "frame " + ms(stats.frame) + " / " + ms(stats.budget) + " ms\n" +
+                       "input " + ms(stats.average[(size_t) Phase::Input]) + "  update " +
+                       ms(stats.average[(size_t) Phase::Update]) + "  draw " +
+                       ms(stats.average[(size_t) Phase::Draw]) + "\n" +
+                       "idle " + ms(stats.average[(size_t) Phase::Idle]) + " ms, tasks " + std::to_string(stats.ran) +
+                       " ran, " + std::to_string(stats.pending) + " queued, " + std::to_string(stats.forced) +
+                       " forced\n" +
+                       "over budget " + std::to_string(stats.overBudget) + " of " + std::to_string(stats.frames);
+
+    _Text.setFont(font);
+    _Text.setCharacterSize(14);
+    _Text.setFillColor(sf::Color::White);
+    _Text.setString(text);
+
+    auto bounds = _Text.getLocalBounds();
+    _Text.setPosition(10, window.getSize().y - bounds.height - bounds.top - 10);
+    _Background.setSize(sf::Vector2f(bounds.width + 10, bounds.height + bounds.top + 10));
+    _Background.setPosition(5, window.getSize().y - bounds.height - bounds.top - 15);
+    _Background.setFillColor(sf::Color(0, 0, 0, 160));
 }
 
+void alone::PerfOverlay::draw(sf::RenderTarget &target, sf::RenderStates states) const {
+    if (!_Visible)
+        return;
+    target.draw(_Background, states);
+    target.draw(_Text, states);
+}
 
 /**
- *  генерация карты, включая рандомное заполнение
-	то же берёт заранее заготовленный уровень сложности из std::array <difficulty_t, 3> difficulties
-	сделано, чтобы игрок не мог проиграть с первого нажатия
- *  @param point это точка, в которую нажал игрок
+ * работа с кнопками
  */
-void Map::generate(size_t level, sf::Vector2u point) {
-    auto &d = difficulties[level];
-    _Bombs = d.bombs;
-
-    /**
-     *  переменная для незаполненных клеток карты
-	    достаточно много весит, вначале 'размер_грани ^ 2 - 1'
-     */
-    std::set<size_t> unfilled;
-
-    /**
-     *  заполняем все точки с карты так, что элемент с индексом 0 - это левый верхний
-	    а с индексом 10 при ширине в 8 тайлов - это элемент с 'x = 1' и 'y = 2'
-     */
-    for (size_t i = 0; i != d.size * d.size; i++)
-        unfilled.emplace(i);
+void alone::input::update() {
+    lrmb.preLmb = lrmb.nowLmb;
+    lrmb.preRmb = lrmb.nowRmb;
+    lrmb.nowLmb = sf::Mouse::isButtonPressed(sf::Mouse::Left);
+    lrmb.nowRmb = sf::Mouse::isButtonPressed(sf::Mouse::Right);
+    lrmb.preMmb = lrmb.nowMmb;
+    lrmb.nowMmb = sf::Mouse::isButtonPressed(sf::Mouse::Middle);
 
     /**
-     * убираем ту самую точку, в которую вначале тыкнул игрок
+     * аккорд срабатывает один раз, когда отпускают первую из двух кнопок
      */
-    unfilled.erase(point.x + point.y * d.size);
+    if (lrmb.nowLmb && lrmb.nowRmb)
+        lrmb.chording = true;
+    lrmb.chordClick = lrmb.chording && !lrmb.chordDone && !(lrmb.nowLmb && lrmb.nowRmb);
+    if (lrmb.chordClick)
+        lrmb.chordDone = true;
 
     /**
-     * рандомный генератор
+     * в кадре, когда отпустили вторую кнопку, её клик тоже глушим
      */
-    std::random_device rd;
+    lrmb.suppress = lrmb.chording;
+    if (!lrmb.nowLmb && !lrmb.nowRmb)
+        lrmb.chording = lrmb.chordDone = false;
 
     /**
-     * заполнение бомб
+     * клавиши, пришедшие с прошлого обновления, становятся текущими
      */
-    for (size_t i = 0; i != _Bombs; i++) {
-        /**
-         * генерация рандомного индекса числа из сета
-         */
-        std::uniform_int_distribution<size_t> dist(0, unfilled.size() - 1);
-        size_t pos = dist(rd);
-        //std::cout << pos << ' ';
-
-        auto it = unfilled.begin();
-        std::advance(it, pos);
-
-        /**
-         * point - это точка, в которую поместят бомбу
-         */
-        size_t point = *it;
-        _Content[point % d.size][point / d.size] = {'n', Type::Bomb};
-        /**
-         * удаляет это точку из unfilled, тк она уже заполнена
-         */
-        unfilled.erase(point);
-    }
-    //std::cout << '\n';
-
-    /**
-     * заполнение чисел вокруг бомб
-     */
-    for (size_t i = 0; i != _Content.size(); i++) {
-        for (size_t j = 0; j != _Content[i].size(); j++) {
+    keys.now.swap(keys.pending);
+    keys.pending.clear();
+    mouseWheel.now = mouseWheel.pending;
+    mouseWheel.pending = 0;
+}
 
-            /**
-             * пропускаем, если здесь есть бомба
-             */
-            if (_Content[i][j].second == Type::Bomb)
-                continue;
+void alone::input::scroll(float delta) {
+    mouseWheel.pending += delta;
+}
 
-            /**
-             * проверяет соседние клетки от тайла
-             */
-            size_t value = _DetectAround(i, j);
+float alone::input::wheel() {
+    return mouseWheel.now;
+}
 
-            /**
-             * изменяет значение кол-ва бомб, если их больше 0
-             */
-            if (value != 0)
-                _Content[i][j].second = (Type) (value - 1);
-        }
-    }
+void alone::input::press(sf::Keyboard::Key key) {
+    keys.pending.push_back(key);
 }
 
-/**
- * проверяет, есть ли бомба по заданному индексу
- * @return если выходит индекс за пределы карты, то возвращает false
- */
-bool Map::_HasBomb(size_t x, size_t y) {
-    if (x < 0 || x >= _Content.size() || y < 0 || y >= _Content.size())
-        return false;
-    return _Content[x][y].second == Type::Bomb;
-};
+bool alone::input::isClickedKey(sf::Keyboard::Key key) {
+    return std::find(keys.now.begin(), keys.now.end(), key) != keys.now.end();
+}
 
 /**
- * проверяет все клетки сверху, снизу, по бокам и по диагонали
- * @return
+ * для левой кнопки мыши
+ * @return выдаёт true только если кнопка была только что поднята
  */
-size_t Map::_DetectAround(size_t x, size_t y) {
-    return _HasBomb(x - 1, y - 1) + _HasBomb(x, y - 1) + _HasBomb(x + 1, y - 1) +
-           _HasBomb(x - 1, y) + _HasBomb(x + 1, y) +
-           _HasBomb(x - 1, y + 1) + _HasBomb(x, y + 1) + _HasBomb(x + 1, y + 1);
-};
+bool alone::input::isClickedLeftButton() {
+    return lrmb.preLmb && !lrmb.nowLmb && !lrmb.suppress;
+}
 
 /**
- *  рекурсивный алгоритм, чтобы открыть тайлы вокруг нажатого
-    получается рекурсия только в том случае, если игрок нажимает по пустому тайлу
+ * для правой
  */
-void Map::_OpenTiles(int x, int y) {
-    if (y >= _Content.size() || y < 0 || x >= _Content.size() || x < 0)
-        return;
-
-    if (_Content[x][y].first == 'r' || _Content[x][y].second != Type::None) {
-
-        /**
-         * ставит статус revealed - проверено
-         */
-        _Content[x][y].first = 'r';
-        return;
-    }
-
-    /**
-     * ставит статус revealed - проверено
-     */
-    _Content[x][y].first = 'r';
-
-    /**
-     * проверка верхних
-     */
-    _OpenTiles(x - 1, y - 1);
-    _OpenTiles(x, y - 1);
-    _OpenTiles(x + 1, y - 1);
+bool alone::input::isClickedRightButton() {
+    return lrmb.preRmb && !lrmb.nowRmb && !lrmb.suppress;
+}
 
-    /**
-     * по бокам
-     */
-    _OpenTiles(x - 1, y);
-    _OpenTiles(x + 1, y);
+bool alone::input::isClickedMiddleButton() {
+    return lrmb.preMmb && !lrmb.nowMmb;
+}
 
-    /**
-     * нижних
-     */
-    _OpenTiles(x - 1, y + 1);
-    _OpenTiles(x, y + 1);
-    _OpenTiles(x + 1, y + 1);
+bool alone::input::isChordClicked() {
+    return isClickedMiddleButton() || lrmb.chordClick;
 }
 
 /**
@@ -337,7 +313,10 @@ void MenuState::onCreate() {
      * устанавливает размер экрана игры
      */
     window.setSize(sf::Vector2u(450, 800));
+    _Layout();
+}
 
+void MenuState::_Layout() {
     /**
      * изменяет размер динамического массива с кнопками по количеству параметров
      */
@@ -379,6 +358,16 @@ void GameOverState::update() {
     auto mouse = sf::Mouse::getPosition(window);
     auto bounds = _Exit.getGlobalBounds();
 
+    /**
+     * ещё раз тот же уровень: возвращаем ту же игру, она перезапускается в onCreate на своей памяти
+     */
+    if (_Game && _Again.getGlobalBounds().contains(mouse.x, mouse.y) && alone::input::isClickedLeftButton()) {
+        states.erase("over");
+        states.insert("game", _Game);
+        _Game.reset();
+        return;
+    }
+
     /**
      * проверка, была ли нажата кнопка выхода из игры
      */
@@ -431,24 +420,29 @@ void GameOverState::onCreate() {
      */
     _Label.setFont(font);
     _Exit.setFont(font);
+    _Again.setFont(font);
 
     /**
      * установка текста
      */
     _Label.setString(text);
     _Exit.setString("Exit");
+    _Again.setString("Play again");
+    _Again.setCharacterSize(42);
 
     /**
      * цвет внутри текста
      */
     _Label.setFillColor(sf::Color::White);
     _Exit.setFillColor(sf::Color::White);
+    _Again.setFillColor(sf::Color::White);
 
     /**
      * цвет обода текста
      */
     _Label.setOutlineColor(sf::Color::White);
     _Exit.setOutlineColor(sf::Color::White);
+    _Again.setOutlineColor(sf::Color::White);
 
     /**
      * установка местоположения для главной надписи о статусе выигрыша игрока
@@ -464,10 +458,19 @@ void GameOverState::onCreate() {
 
     auto exitBounds = _Exit.getGlobalBounds();
 
+    /**
+     * кнопка повтора под кнопкой выхода, только если есть игра, которую можно повторить
+     */
+    float againHeight = 0;
+    if (_Game) {
+        _Again.setPosition(20, exitBounds.top + exitBounds.height + 20);
+        againHeight = _Again.getGlobalBounds().height + 20;
+    }
+
     /**
      * установка размера окна в зависимости от размера надписи о статусе выигрыша игрока
      */
-    window.setSize(sf::Vector2u(labelBounds.width + 80, labelBounds.height + 80 + exitBounds.height));
+    window.setSize(sf::Vector2u(labelBounds.width + 80, labelBounds.height + 80 + exitBounds.height + againHeight));
 }
 
 /**
@@ -483,6 +486,8 @@ void GameOverState::onDelete() {
 void GameOverState::draw(sf::RenderTarget &target, sf::RenderStates states) const {
     target.draw(_Label, states);
     target.draw(_Exit, states);
+    if (_Game)
+        target.draw(_Again, states);
 }
 
 void GameState::update() {
@@ -490,20 +495,20 @@ void GameState::update() {
     /**
      * размер грани карты
      */
-    size_t edge_size = _GameMap->_Content.size();
+    size_t edge_size = _GameMap->size();
+
+    auto &map = *_GameMap;
 
     /**
-     * меняем размер массива вершин для карты игры
-	    умножаем на 4, тк квадратная карта
+     * клетки и счётчики, которые симуляция успела посчитать с прошлого кадра
      */
-    _RenderRegion.resize(4 * edge_size * edge_size);
-
-    auto &map = _GameMap->_Content;
+    if (_Sim.running())
+        _SyncSim();
 
     /**
-     * получения количества секунд после начала уровня
+     * получения количества секунд после начала уровня, в повторе - времени внутри повтора
      */
-    auto time = _Clock.getElapsedTime();
+    auto time = _Playback ? _PlaybackTime : _Clock.getElapsedTime() + _TimeOffset;
     size_t seconds = time.asSeconds();
 
     /**
@@ -517,237 +522,679 @@ void GameState::update() {
     auto mouse = sf::Mouse::getPosition(window);
 
     /**
-     * Проверка на нажатие и его исход
+     * колесо мыши - приближение и отдаление, точка под курсором остаётся на месте
+     */
+    float wheel = alone::input::wheel();
+    if (wheel != 0 && mouse.y >= (int) _InterfaceOffset) {
+        auto before = window.mapPixelToCoords(mouse, _Camera);
+
+        /**
+         * отдалять можно, пока карта не станет вчетверо меньше окна
+         */
+        float fit = edge_size * 32.f / std::max(1.f, std::min(_Camera.getSize().x, _Camera.getSize().y) / _Zoom);
+        _Zoom = std::clamp(_Zoom * std::pow(0.8f, wheel), 0.25f, std::max(1.f, fit) * 4);
+        _FitCamera();
+        _Camera.move(before - window.mapPixelToCoords(mouse, _Camera));
+        _CacheValid = false;
+    }
+
+    /**
+     * нажатие по миникарте переносит туда камеру, на саму карту оно не попадает, миникарта в интерфейсе
      */
-    bool contains = mouse.x >= 0 && mouse.x <= edge_size * 32 && mouse.y >= _InterfaceOffset &&
-                    mouse.y <= edge_size * 32 + _InterfaceOffset;
+    auto minimap = _MinimapArea();
+    if (alone::input::isClickedLeftButton() && minimap.contains(mouse.x, mouse.y)) {
+        float side = edge_size * 32.f;
+        _Camera.setCenter((mouse.x - minimap.left) / minimap.width * side,
+                          _InterfaceOffset + (mouse.y - minimap.top) / minimap.height * side);
+    }
 
     /**
-     * если нажали, то проверяем, что там было
+     * Проверка на нажатие и его исход, точка на карте считается через камеру
      */
-    if (contains) {
+    auto world = window.mapPixelToCoords(mouse, _Camera);
+    bool contains = mouse.x >= 0 && mouse.x < (int) window.getSize().x && mouse.y >= (int) _InterfaceOffset &&
+                    mouse.y < (int) window.getSize().y && world.x >= 0 && world.x < edge_size * 32 &&
+                    world.y >= _InterfaceOffset && world.y < edge_size * 32 + _InterfaceOffset;
+
+    /**
+     * F2 - новая партия того же уровня прямо в этом состоянии, брошенная игра не сохраняется
+     */
+    if (!_Playback && !_Busy() && alone::input::isClickedKey(sf::Keyboard::F2)) {
+        if (_Autosave.valid())
+            _Autosave.wait();
+        std::remove(save::Path.c_str());
+        _Restart();
+        return;
+    }
+
+    /**
+     * T включает режим тренировки, в нём Z отменяет ход, а Y возвращает
+     */
+    if (!_Playback && !_Busy())
+        _UpdateTraining();
+
+    /**
+     * в режиме просмотра повтора клики берутся из записи, а не с мышки
+     */
+    if (_Playback)
+        _UpdatePlayback();
+
+        /**
+         * если нажали, то проверяем, что там было, после проигрыша в тренировке можно только отменять
+         */
+    else if (contains && _GameStatus == 'a') {
         /**
          * точка, в которую попали мышкой
          */
-        auto point = sf::Vector2u(mouse.x / 32, (mouse.y - _InterfaceOffset) / 32);
+        auto point = sf::Vector2u(world.x / 32, (world.y - _InterfaceOffset) / 32);
 
         /**
-         * если левая кнопка мыши нажата
+         * любой клик по карте - повод для автосохранения
          */
-        if (alone::input::isClickedLeftButton()) {
-
-            /**
-             * карта генерируется в момент первого нажатия на карту
-             */
-            if (_Revealed == 0) {
-
-                /**
-                 * генерация
-                 */
-                _GameMap->generate(_Level, point);
+        if (alone::input::isClickedLeftButton() || alone::input::isClickedRightButton() ||
+            alone::input::isChordClicked())
+            _Unsaved = true;
 
-                /**
-                 * устанавливаем текст с количеством оставшихся для поиска бомб
-                 */
-                _RemainedLabel.setString("Bombs remained: " + std::to_string(_GameMap->_Bombs));
-                _Revealed++;
-
-                /**
-                 * если сгенерировалось в этой точке ничего, то ищем ближайшие пустые тайлы и с цифрами
-                 */
-                if (map[point.x][point.y].second == Type::None)
-
-                    /**
-                     * алгоритм рекурсивный
-                     */
-                    _GameMap->_OpenTiles(point.x, point.y);
-                else
-
-                    /**
-                     * если статус отрисовки "неизвестный"
-                     */
-                    map[point.x][point.y].first = 'r';
-            } else {
-                if (map[point.x][point.y].first == 'n') {
-                    if (map[point.x][point.y].second == Type::None)
-
-                        /**
-                         * то открываем рядом пустые тайлы до цифр
-                         */
-                        _GameMap->_OpenTiles(point.x, point.y);
-                    else
-                        /**
-                         * установка статуса "видимый"
-                         */
-                        map[point.x][point.y].first = 'r';
-
-                        /**
-                         * если игрок нажал по бомбе левой кнопкой мыши, то он проиграл
-                         */
-                    if (map[point.x][point.y].second == Type::Bomb)
-                        _GameStatus = 'l';
-
-                    _Revealed++;
-                }
-            }
+        /**
+         * аккорд по числу
+         */
+        if (alone::input::isChordClicked())
+            _Apply(replay::Action::Chord, point);
 
             /**
-             * это проверка на нажатие левой кнопкой мыши
+             * если левая кнопка мыши нажата
              */
-        } else if (alone::input::isClickedRightButton()) {
+        else if (alone::input::isClickedLeftButton())
+            _Apply(replay::Action::Left, point);
 
             /**
-             * если изначально статус тайла был флаг
+             * это проверка на нажатие правой кнопкой мыши
              */
-            if (map[point.x][point.y].first == 'f') {
+        else if (alone::input::isClickedRightButton())
+            _Apply(replay::Action::Right, point);
+    }
 
-                /**
-                 * то меняем его на противоположный
-                 */
-                map[point.x][point.y].first = 'n';
+    /**
+     * без симуляции заливка идёт тут, кусками, пока не кончится время кадра
+     */
+    if (!_Sim.running() && map.flooding()) {
+        sf::Clock budget;
+        while (map.step(FloodSlice) != 0 && budget.getElapsedTime().asSeconds() < FloodBudget);
+        _GameStatus = _EndStatus();
+    }
 
-                /**
-                 * не забывая обновить счётчик бомб
-                 */
-                _RemainedLabel.setString("Bombs remained: " + std::to_string(++_GameMap->_Bombs));
+    /**
+     *  расчёт вершин для карты
+	    целиком только после генерации или загрузки, иначе только изменившиеся за кадр клетки
+	    ходы из симуляции свои клетки уже прислали, а здесь остаются перезапуск и отмена ходов
+	    положения вершин пересчитываются только при смене размера, новой партии хватает текстур
+     */
+    if (!_Busy()) {
+        if (_RenderRegion.getVertexCount() != 4 * edge_size * edge_size) {
+            buildMesh(map, _RenderRegion, _InterfaceOffset, alone::JobSystem::shared());
+            _CacheValid = _LodValid = false;
+        } else if (map.allDirty()) {
+            retextureMesh(map, _RenderRegion, alone::JobSystem::shared());
+            _CacheValid = _LodValid = false;
+        } else {
+            updateMesh(map, _RenderRegion, map.dirty());
+            _Changed.insert(_Changed.end(), map.dirty().begin(), map.dirty().end());
+        }
+        map.clearDirty();
+    }
 
-                /**
-                 * и уменьшая количество правильно расположенных на карте флагов
-                 */
-                if (map[point.x][point.y].second == Type::Bomb)
-                    _Flags--;
+    /**
+     * F4 - карта из кэша или вершинами
+     */
+    if (alone::input::isClickedKey(sf::Keyboard::F4)) {
+        _Renderer = _Renderer == Renderer::Cached ? Renderer::Vertices : Renderer::Cached;
+        _CacheValid = false;
+    }
+    _LodPending.insert(_LodPending.end(), _Changed.begin(), _Changed.end());
+    _UpdateCache();
 
-                /**
-                 * если же на тайле не было флага
-                 */
-            } else if (map[point.x][point.y].first == 'n') {
+    if (_Busy())
+        return;
+    _UpdateLod();
 
-                /**
-                 * то ставим его
-                 */
-                map[point.x][point.y].first = 'f';
-                _RemainedLabel.setString("Bombs remained: " + std::to_string(--_GameMap->_Bombs));
+    /**
+     * автосохранение не чаще раза в 5 секунд и только если предыдущее уже записалось
+     */
+    bool saving = _Autosave.valid() && _Autosave.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+    if (_Unsaved && !_Playback && !_Training && _Started() && _GameStatus == 'a' && !saving &&
+        !_AutosaveQueued && _AutosaveClock.getElapsedTime() > sf::seconds(5)) {
+        _AutosaveQueued = true;
+        _Defer(alone::FrameScheduler::Priority::Low, &GameState::_RunAutosave);
+    }
 
-                /**
-                 * если всё верно, то инкрементируем счётчик правильных флагов, который не виден игроку
-                 */
-                if (map[point.x][point.y].second == Type::Bomb)
-                    _Flags++;
+    /**
+     * проверка того, закончилась ли игра, проигрыш в тренировке ждёт отмены хода
+     */
+    if (_GameStatus == 'w' || (_GameStatus == 'l' && !_Training)) {
 
-                /**
-                 * если все бомбы найдены, то игра заканчивается, а игрок выигрывает
-                 */
-                if (_Flags == difficulties[_Level].bombs) {
-                    _GameStatus = 'w';
-                }
-            }
-        }
+        /**
+         * законченную игру продолжать нельзя, сохранение больше не нужно
+         */
+        if (_Autosave.valid())
+            _Autosave.wait();
+        if (!_Playback)
+            std::remove(save::Path.c_str());
+        _Recorder.stop();
+
+        /**
+         * экран конца игры держит это состояние, чтобы сыграть ещё раз без пересоздания
+         */
+        states.erase("game");
+        states.insert("over", std::shared_ptr<State>(
+                new GameOverState(_GameStatus == 'w', map.correctFlags(), shared_from_this())));
     }
+}
 
 /**
- * расчёт вершин для карты
+ * один ход игрока, одинаково для мышки и для повтора
  */
-    for (size_t i = 0; i != map.size(); i++) {
-        for (size_t j = 0; j != map[i].size(); j++) {
+void GameState::_Apply(replay::Action action, sf::Vector2u point) {
 
-            /**
-             * это 4 вершины одного квадрата
-             */
-            auto &top_lhs = _RenderRegion[(i + j * map.size()) * 4];
-            auto &top_rhs = _RenderRegion[(i + j * map.size()) * 4 + 1];
-            auto &bot_rhs = _RenderRegion[(i + j * map.size()) * 4 + 2];
-            auto &bot_lhs = _RenderRegion[(i + j * map.size()) * 4 + 3];
+    /**
+     * время хода для повтора
+     */
+    uint32_t time = (_Clock.getElapsedTime() + _TimeOffset).asMilliseconds();
 
-            /**
-             * это id для отрисовки квадрата, показывает, какую точку у атласа с текстурами рисовать
-             */
-            size_t id = 0;
+    if (_Sim.running()) {
+        _Sim.push({action, point.x, point.y, time});
+        return;
+    }
 
-            /**
-             * если тайл виден игроку, то
-             */
-            if (DEBUG_MODE || map[i][j].first == 'r')
+    _Move(action, point, time);
+    _GameStatus = _EndStatus();
+    _RemainedLabel.setString("Bombs remained: " + std::to_string(_GameMap->_Bombs));
+}
 
-                /**
-                 * просто ставим то, что там есть
-                 */
-                id = (size_t) map[i][j].second;
+void GameState::_Move(replay::Action action, sf::Vector2u point, uint32_t time) {
+    auto &map = *_GameMap;
 
-                /**
-                 * если тут флаш
-                 */
-            else if (map[i][j].first == 'f')
-                /**
-                 * то говорим рисовать флаг
-                 */
-                id = (size_t) Type::Flag;
-            else
-                /**
-                 * иначе просто рисуем пустоту
-                 */
-                id = (size_t) Type::Unknown;
+    /**
+     * карта клетки не проверяет, мышка и повтор обязаны давать точки внутри неё
+     */
+    assert(point.x < map.size() && point.y < map.size());
 
+    /**
+     * всё, что поменяет этот ход, отменяется одним шагом
+     */
+    map.beginMove();
 
-                /**
-                 * это id с самой текстурами, так как текстура квадратная
-                 */
-            size_t idx = id % 4;
-            size_t idy = id / 4;
+    if (action == replay::Action::Left) {
+
+        /**
+         *  карта уже сгенерирована в onCreate, первое нажатие только убирает бомбу из-под курсора
+	        зерно и точка запоминаются для повтора
+         */
+        if (!_Started()) {
+            map.makeSafe(point, _Seed + 1);
+            if (!_Playback && !_Training)
+                _Recorder.start(replay::Path, _Level, _Seed, point);
+        }
+
+        if (map.at(point.x, point.y).first == 'n') {
 
             /**
-             * расчёт местоположения на экране, включая смещение интерфейса по вертикали
+             * если игрок нажал по бомбе левой кнопкой мыши, то он проиграл
              */
-            top_lhs.position = sf::Vector2f(i * 32, _InterfaceOffset + j * 32);
-            top_rhs.position = sf::Vector2f(i * 32 + 32, _InterfaceOffset + j * 32);
-            bot_rhs.position = sf::Vector2f(i * 32 + 32, _InterfaceOffset + j * 32 + 32);
-            bot_lhs.position = sf::Vector2f(i * 32, _InterfaceOffset + j * 32 + 32);
+            map.reveal(point.x, point.y);
+            _Revealed++;
+        }
+    } else if (action == replay::Action::Chord) {
+
+        /**
+         * до первого нажатия карты ещё нет, аккордить нечего
+         */
+        if (_Started())
+            map.chord(point.x, point.y);
+    } else if (action == replay::Action::Right && _Started()) {
+
+        /**
+         * флаги до первого нажатия не ставятся, иначе makeSafe мог бы унести бомбу из-под флага
+         */
+        char state = map.toggleFlag(point.x, point.y);
+
+        /**
+         * если флаг сняли, не забывая обновить счётчик бомб
+         */
+        if (state == 'n')
+            map._Bombs++;
 
             /**
-             * расчёт 4 вершин с текстуры, которые соответствуют реальной картинке с экрана
+             * если же на тайле не было флага, а теперь есть
              */
-            top_lhs.texCoords = sf::Vector2f(idx * 32.f, idy * 32.f);
-            top_rhs.texCoords = sf::Vector2f(idx * 32.f + 32, idy * 32.f);
-            bot_rhs.texCoords = sf::Vector2f(idx * 32.f + 32, idy * 32.f + 32);
-            bot_lhs.texCoords = sf::Vector2f(idx * 32.f, idy * 32.f + 32);
+        else if (state == 'f')
+            map._Bombs--;
+    }
+
+    /**
+     * партии с отменой ходов в повтор не пишутся
+     */
+    if (!_Playback && !_Training && _Started())
+        _Recorder.append({time, action, point.x, point.y});
+}
+
+/**
+ *  конец игры проверяется один раз после хода, по счётчикам карты за O(1)
+    проигрыш - открыта бомба, выигрыш - открыты все безопасные клетки или флаги стоят ровно на всех бомбах
+ */
+char GameState::_EndStatus() const {
+    auto &map = *_GameMap;
+    if (_Started()) {
+        if (map.exploded() != 0)
+            return 'l';
+        else if (map.hiddenSafe() == 0 || (map.correctFlags() == map.mines().size() && map.wrongFlags() == 0))
+            return 'w';
+    }
+    return 'a';
+}
+
+bool GameState::_Started() const {
+    auto &map = *_GameMap;
+    return map.hiddenSafe() + map.mines().size() != map.size() * map.size() || map.flooding();
+}
+
+sim::Frame GameState::_SimFrame() const {
+    return sim::Frame{_GameMap->_Bombs, _EndStatus(), _GameMap->flooding()};
+}
+
+void GameState::_ResetCamera() {
+    _Zoom = 1;
+    _FitCamera();
+    float side = _GameMap->size() * 32.f;
+    _Camera.setCenter(side / 2, _InterfaceOffset + side / 2);
+}
+
+void GameState::_FitCamera() {
+    sf::Vector2f size(window.getSize());
+    float board = std::max(1.f, size.y - _InterfaceOffset);
+    _Camera.setViewport(sf::FloatRect(0, _InterfaceOffset / std::max(1.f, size.y), 1, board / std::max(1.f, size.y)));
+    _Camera.setSize(size.x * _Zoom, board * _Zoom);
+}
+
+size_t GameState::_LodLevelFor() const {
+    float tile = 32 / _Zoom;
+    if (tile >= LodPixels || _Lod.levels() == 0)
+        return _Lod.levels();
+
+    /**
+     * самый подробный уровень, у которого квадрат не меньше пикселя
+     */
+    size_t level = 0;
+    while (level + 1 != _Lod.levels() && LodPyramid::span(level) * tile < 1)
+        level++;
+    return level;
+}
+
+void GameState::_UpdateLod() {
+    auto &map = *_GameMap;
+    if (!_LodValid) {
+        _Lod.build(map);
+        _LodPending.clear();
+        _LodLevel = -1;
+        _LodValid = true;
+        _MinimapValid = false;
+    } else if (!_LodPending.empty())
+        _Lod.update(map, _LodPending);
+
+    _QueueMinimap();
+    _LodPending.clear();
+
+    size_t level = _LodLevelFor();
+    if (level == _Lod.levels()) {
+        _LodLevel = -1;
+        _Lod.clearChanged();
+        return;
+    }
+
+    /**
+     *  при смене уровня текстура собирается заново, она размером с экран, а не с карту
+	    иначе перекрашиваются только изменившиеся квадраты
+     */
+    size_t n = _Lod.side(level);
+    auto paint = [&](size_t cell) {
+        auto color = lodColor(_Lod.at(level, cell % n, cell / n));
+        sf::Uint8 *pixel = &_LodPixels[cell * 4];
+        pixel[0] = color.r;
+        pixel[1] = color.g;
+        pixel[2] = color.b;
+        pixel[3] = color.a;
+    };
+
+    if (level != _LodLevel) {
+        _LodPixels.resize(n * n * 4);
+        for (size_t cell = 0; cell != n * n; cell++)
+            paint(cell);
+        _LodTexture.create(n, n);
+        _LodTexture.update(_LodPixels.data());
+        _LodLevel = level;
+    } else {
+        auto &changed = _Lod.changed(level);
+        for (size_t cell: changed)
+            paint(cell);
+
+        /**
+         * немного квадратов - по одному, много - всю текстуру одним вызовом
+         */
+        if (changed.size() < n)
+            for (size_t cell: changed)
+                _LodTexture.update(&_LodPixels[cell * 4], 1, 1, cell % n, cell / n);
+        else if (!changed.empty())
+            _LodTexture.update(_LodPixels.data());
+    }
+    _Lod.clearChanged();
+}
+
+sf::FloatRect GameState::_MinimapArea() const {
+    float left = window.getSize().x - MinimapSide - 10;
+    float labels = std::max(_RemainedLabel.getGlobalBounds().left + _RemainedLabel.getGlobalBounds().width,
+                            _TimerLabel.getGlobalBounds().left + _TimerLabel.getGlobalBounds().width);
+    if (left < labels + 10)
+        return {};
+    return {left, 10, MinimapSide, MinimapSide};
+}
+
+size_t GameState::_MinimapLevel(size_t &edge) const {
+    /**
+     * пиксель на клетку, пока карта не больше MinimapTiles, иначе уровень пирамиды не больше этого
+     */
+    size_t level = -1;
+    edge = _GameMap->size();
+    for (size_t i = 0; edge > MinimapTiles && i != _Lod.levels(); i++) {
+        level = i;
+        edge = _Lod.side(i);
+    }
+    return level;
+}
+
+void GameState::_QueueMinimap() {
+    size_t n;
+    size_t level = _MinimapLevel(n);
+    auto &changed = level == (size_t) -1 ? _LodPending : _Lod.changed(level);
+    _MinimapPending.insert(_MinimapPending.end(), changed.begin(), changed.end());
+
+    /**
+     * если изменений накопилось больше, чем точек, дешевле перерисовать всё
+     */
+    if (_MinimapPending.size() > n * n) {
+        _MinimapPending.clear();
+        _MinimapValid = false;
+    }
+
+    if (!_MinimapQueued && (!_MinimapValid || !_MinimapPending.empty())) {
+        _MinimapQueued = true;
+        _Defer(alone::FrameScheduler::Priority::Normal, &GameState::_UpdateMinimap);
+    }
+}
+
+bool GameState::_UpdateMinimap() {
+    if (_Busy() || !_LodValid)
+        return false;
+    _MinimapQueued = false;
+
+    auto &map = *_GameMap;
+    size_t n;
+    size_t level = _MinimapLevel(n);
+
+    auto paint = [&](size_t i) {
+        LodPyramid::cell_t cell;
+        if (level == (size_t) -1) {
+            auto &tile = map.at(i % n, i / n);
+            cell.revealed = tile.first == 'r' ? 255 : 0;
+            cell.flagged = tile.first == 'f';
+            cell.exploded = tile.first == 'r' && tile.second == Type::Bomb;
+        } else
+            cell = _Lod.at(level, i % n, i / n);
+
+        auto color = lodColor(cell);
+        sf::Uint8 *pixel = &_MinimapPixels[i * 4];
+        pixel[0] = color.r;
+        pixel[1] = color.g;
+        pixel[2] = color.b;
+        pixel[3] = color.a;
+    };
+
+    if (!_MinimapValid || n != _MinimapEdge) {
+        _MinimapPixels.resize(n * n * 4);
+        for (size_t i = 0; i != n * n; i++)
+            paint(i);
+        _MinimapTexture.create(n, n);
+        _MinimapTexture.update(_MinimapPixels.data());
+        _MinimapEdge = n;
+        _MinimapValid = true;
+        _MinimapPending.clear();
+        return true;
+    }
+
+    /**
+     * перекрашиваем изменившиеся точки и запоминаем их строки
+     */
+    if (_MinimapPending.empty())
+        return true;
+    std::vector<bool> rows(n);
+    for (size_t i: _MinimapPending) {
+        paint(i);
+        rows[i / n] = true;
+    }
+    _MinimapPending.clear();
+
+    /**
+     * подряд идущие изменившиеся строки заливаются одним вызовом
+     */
+    for (size_t y = 0; y != n;) {
+        if (!rows[y]) {
+            y++;
+            continue;
         }
+        size_t from = y;
+        while (y != n && rows[y])
+            y++;
+        _MinimapTexture.update(&_MinimapPixels[from * n * 4], n, y - from, 0, from);
+    }
+    return true;
+}
+
+void GameState::_UpdateCache() {
+    if (_Renderer != Renderer::Cached) {
+        _Changed.clear();
+        return;
+    }
+
+    unsigned side = _GameMap->size() * 32;
+    if (!_CacheValid) {
+        /**
+         * текстура пересоздаётся только при другом размере карты
+         */
+        if (_Cache.getSize() != sf::Vector2u(side, side) &&
+            (side > sf::Texture::getMaximumSize() || !_Cache.create(side, side))) {
+            _Renderer = Renderer::Vertices;
+            return;
+        }
+
+        /**
+         * вершины стоят с отступом под интерфейс, вид кэша этот отступ убирает
+         */
+        _Cache.setView(sf::View(sf::FloatRect(0, _InterfaceOffset, side, side)));
+        _Cache.clear();
+        _Cache.draw(_RenderRegion, _Atlas);
+    } else if (!_Changed.empty()) {
+
+        /**
+         * клетки непрозрачные, поэтому новые квадраты просто закрашивают старые
+         */
+        _Patch.resize(_Changed.size() * 4);
+        for (size_t i = 0; i != _Changed.size(); i++)
+            for (size_t k = 0; k != 4; k++)
+                _Patch[i * 4 + k] = _RenderRegion[_Changed[i] * 4 + k];
+        _Cache.draw(_Patch, _Atlas);
+    } else
+        return;
+
+    _Cache.display();
+    _CacheValid = true;
+    _Changed.clear();
+}
+
+/**
+ * клетки прямо в вершины, картинки уже посчитаны в симуляции
+ */
+void GameState::_SyncSim() {
+    _Sim.drain(_Tiles);
+    for (auto &tile: _Tiles) {
+        setTile(_RenderRegion, tile.index, tile.id);
+        _Changed.push_back(tile.index);
+    }
+
+    sim::Frame frame;
+    if (_Sim.frame(frame)) {
+        _GameStatus = frame.status;
+        _RemainedLabel.setString("Bombs remained: " + std::to_string(frame.bombs));
+    }
+}
+
+/**
+ *  режим тренировки: карта ведёт историю ходов, Z отменяет, Y возвращает
+    отмена проигрышного хода возвращает игру в активное состояние
+ */
+void GameState::_UpdateTraining() {
+    auto &map = *_GameMap;
+
+    if (alone::input::isClickedKey(sf::Keyboard::T)) {
+        _Training = !_Training;
+        map.setProgressive(!_Training);
+        map.setHistory(_Training);
+    }
+    if (!_Training)
+        return;
+
+    bool changed = false;
+    if (alone::input::isClickedKey(sf::Keyboard::Z))
+        changed = map.undo();
+    else if (alone::input::isClickedKey(sf::Keyboard::Y))
+        changed = map.redo();
+
+    if (changed) {
+        _GameStatus = _EndStatus();
+        _RemainedLabel.setString("Bombs remained: " + std::to_string(map._Bombs));
     }
+}
+
+/**
+ *  воспроизведение повтора в реальном времени или в несколько раз быстрее
+    стрелки вправо и влево меняют скорость, End доигрывает повтор сразу
+ */
+void GameState::_UpdatePlayback() {
+    if (alone::input::isClickedKey(sf::Keyboard::Right))
+        _Speed *= 2;
+    if (alone::input::isClickedKey(sf::Keyboard::Left))
+        _Speed = std::max(0.25f, _Speed / 2);
 
     /**
-     * проверка того, закончилась ли игра
+     * время повтора идёт со своей скоростью, поэтому копим его по кадрам
      */
-    if (_GameStatus != 'a') {
+    _PlaybackTime += _PlaybackClock.restart() * _Speed;
+    if (alone::input::isClickedKey(sf::Keyboard::End))
+        _PlaybackTime = sf::seconds(1e9f);
+
+    auto &events = _Playback->events;
+    while (_Next != events.size() && _GameStatus == 'a' &&
+           sf::milliseconds(events[_Next].time) <= _PlaybackTime) {
+        auto &event = events[_Next++];
+        _Apply(event.action, sf::Vector2u(event.x, event.y));
+    }
+
+    /**
+     * после конца повтора можно выйти в меню
+     */
+    if (_Next == events.size() && _GameStatus == 'a' && alone::input::isClickedKey(sf::Keyboard::Escape)) {
         states.erase("game");
-        states.insert("over", std::shared_ptr<State>(new GameOverState(_GameStatus == 'w', _Flags)));
+        states.insert("menu", std::shared_ptr<State>(new MenuState()));
     }
 }
 
-void GameState::onCreate() {
+/**
+ *  карта и зерно новой партии: зерно из повтора, готовая карта из фоновой очереди или генерация на месте
+    трогает только переданную карту и очередь под её мьютексом, поэтому может идти в фоне
+ */
+uint64_t GameState::_PrepareBoard(Map &map, size_t level, const replay::Replay *playback) {
+    uint64_t seed;
+    pregen::Ready ready;
+    if (playback)
+        seed = playback->seed;
+    else if (boards.take(level, ready)) {
+
+        /**
+         *  готовая карта из фоновой очереди, генерировать ничего не надо
+	        карты меняются местами, а память старой уходит потоку под следующую заготовку
+         */
+        std::swap(map, ready.map);
+        boards.recycle(std::move(ready.map));
+        return ready.seed;
+    } else {
+        std::random_device rd;
+        seed = ((uint64_t) rd() << 32) | rd();
+    }
+
     /**
-     * обнуляем таймер, так как игра началась!
+     * очередь пуста, тогда новая карта генерируется сразу, чтобы первое нажатие ничего не ждало
      */
-    _Clock.restart();
+    if (map.size() != difficulties[level].size)
+        map.resize(level);
+    map.generate(difficulties[level].bombs, seed);
+    return seed;
+}
 
+/**
+ *  новая партия в том же состоянии: счётчики в ноль, новая карта в старую память
+    вершины и надписи остаются, buildMesh перестроит их на месте
+ */
+void GameState::_Restart() {
+    uint64_t seed = _Resume ? 0 : _PrepareBoard(*_GameMap, _Level, _Playback.get());
+    _StartGame(seed);
+}
+
+void GameState::_StartGame(uint64_t seed) {
     /**
-     * сбрасываем карту игру и изменяем её размер в зависимости от уровня сложности
+     * обнуляем таймер, так как игра началась!
      */
-    _GameMap.reset(new Map());
-    _GameMap->resize(_Level);
+    _Clock.restart();
+    _TimeOffset = sf::Time::Zero;
+    _AutosaveClock.restart();
 
     /**
      * количество открытых клеток с карты равно 0
      */
     _Revealed = 0;
+    _GameStatus = 'a';
+    _Unsaved = false;
+    _Next = 0;
+    _PlaybackTime = sf::Time::Zero;
+    _PlaybackClock.restart();
+    _Seed = seed;
 
     /**
-     * размер ребра карты
+     * если продолжаем сохранённую игру, то забираем оттуда карту, счётчики и время
      */
-    size_t edge_size = _GameMap->_Content.size();
+    if (_Resume) {
+        *_GameMap = std::move(_Resume->map);
+        _GameMap->_Bombs = _Resume->remained;
+        _Revealed = _Resume->revealed;
+        _TimeOffset = sf::microseconds(_Resume->elapsed);
+        _Resume.reset();
+    }
 
     /**
-     * размер экрана игры зависит от размера самой карты
+     * карта из очереди или сохранения приходит без истории
      */
-    window.setSize(sf::Vector2u(edge_size * 32, edge_size * 32 + _InterfaceOffset));
+    _GameMap->setProgressive(!_Training);
+    _GameMap->setHistory(_Training);
+    _RemainedLabel.setString("Bombs remained: " + std::to_string(_GameMap->_Bombs));
+}
 
+void GameState::onCreate() {
     /**
      * атлас текстур
      */
@@ -758,6 +1205,9 @@ void GameState::onCreate() {
      */
     _RemainedLabel.setFont(font);
     _TimerLabel.setFont(font);
+    _LoadingLabel.setFont(font);
+    _LoadingLabel.setString("Loading...");
+    _LoadingLabel.setPosition(50, 100);
 
     /**
      * цвет внутри
@@ -786,19 +1236,184 @@ void GameState::onCreate() {
     }
 }
 
+alone::Coroutine GameState::onLoad() {
+    /**
+     *  карта создаётся один раз, при повторной игре остаётся с прошлой партии
+	    в фоне только выделение и генерация карты, пока они идут, отложенные задачи карту не трогают (_Busy)
+	    всё остальное, что делает _Restart, идёт уже в главном потоке
+     */
+    _Loading = true;
+    if (!_GameMap)
+        _GameMap.reset(new Map());
+    uint64_t seed = 0;
+    if (!_Resume) {
+        auto board = alone::background([map = _GameMap.get(), level = _Level, playback = _Playback] {
+            return _PrepareBoard(*map, level, playback.get());
+        });
+        seed = co_await board;
+    }
+    _Loading = false;
+    _StartGame(seed);
+
+    /**
+     * живая игра идёт в потоке симуляции, после конца игры ходы уже ничего не меняют
+     */
+    if (!_Playback)
+        _Sim.start(*_GameMap, [this](const sim::Move &move) {
+            if (_EndStatus() == 'a')
+                _Move(move.action, sf::Vector2u(move.x, move.y), move.time);
+            return _SimFrame();
+        }, [this]() {
+            _GameMap->step(FloodSlice);
+            return _SimFrame();
+        });
+
+    /**
+     * размер ребра карты
+     */
+    size_t edge_size = _GameMap->size();
+
+    /**
+     * размер экрана игры зависит от размера самой карты, если окно уже такое, то не трогаем
+     */
+    sf::Vector2u size(edge_size * 32, edge_size * 32 + _InterfaceOffset);
+    if (window.getSize() != size)
+        window.setSize(size);
+    _ResetCamera();
+}
+
+void GameState::drawLoading(sf::RenderTarget &target, sf::RenderStates states) const {
+    target.draw(_LoadingLabel, states);
+}
+
 /**
- * тут же при удалении лучше перестраховаться и обнулить умный указатель
+ *  карта не освобождается, состояние может вернуться через "Play again"
+    память уйдёт вместе с самим состоянием
  */
 void GameState::onDelete() {
-    _GameMap.reset(nullptr);
+    _Sim.stop();
+    _Recorder.stop();
+    if (_Autosave.valid())
+        _Autosave.wait();
+}
+
+/**
+ * счётчики текущей игры для сохранения, карта идёт отдельно
+ */
+save::Progress GameState::_Progress() const {
+    save::Progress progress;
+    progress.level = _Level;
+    progress.revealed = _Revealed;
+    progress.remained = _GameMap->_Bombs;
+    progress.elapsed = (_Clock.getElapsedTime() + _TimeOffset).asMicroseconds();
+    return progress;
+}
+
+bool GameState::_RunAutosave() {
+    if (_Busy())
+        return false;
+    _AutosaveQueued = false;
+    if (_Unsaved && !_Playback && !_Training && _Started() && _GameStatus == 'a')
+        _StartAutosave();
+    return true;
+}
+
+void GameState::_Defer(alone::FrameScheduler::Priority priority, bool (GameState::*task)()) {
+    frames.post(priority, [self = weak_from_this(), task] {
+        auto state = std::static_pointer_cast<GameState>(self.lock());
+        return !state || (state.get()->*task)();
+    });
+}
+
+void GameState::_StartAutosave() {
+    /**
+     *  карта кодируется сразу в байты файла в главном потоке, в фон уходит только запись
+	    сохраняются только уровни из difficulties, самый большой - 20x20, это около 2 мкс (bench, save::encode)
+	    на 2048x2048 то же стоило бы ~11 мс, больших карт в игре нет, для них понадобилась бы копия при записи по блокам
+     */
+    auto data = std::make_shared<std::vector<uint8_t>>();
+    save::encode(_Progress(), *_GameMap, *data);
+    _Autosave = std::async(std::launch::async, [data]() {
+        return save::write(save::Path, *data);
+    });
+    _AutosaveClock.restart();
+    _Unsaved = false;
+}
+
+/**
+ * незаконченная игра сохраняется сразу, тут уже можно подождать
+ */
+void GameState::onClose() {
+    _Sim.stop();
+    _Recorder.stop();
+    if (_Autosave.valid())
+        _Autosave.wait();
+    if (_GameMap && !_Playback && !_Training && _Started() && _GameStatus == 'a') {
+
+        /**
+         * в файл идёт карта с доделанной заливкой, очередь обхода не сохраняется
+         */
+        _GameMap->finish();
+        std::vector<uint8_t> data;
+        save::encode(_Progress(), *_GameMap, data);
+        save::write(save::Path, data);
+    }
+}
+
+/**
+ * новое окно - камера заново подгоняется под поле, кэш карты пересобирается
+ */
+void GameState::onResize(sf::Vector2u size) {
+    _FitCamera();
+    _CacheValid = false;
 }
 
 /**
  * отрисовка самой игры
  */
 void GameState::draw(sf::RenderTarget &target, sf::RenderStates states) const {
-    states.texture = _Atlas;
-    target.draw(_RenderRegion, states);
+    /**
+     * карта через камеру, интерфейс через вид окна
+     */
+    auto hud = target.getView();
+    target.setView(_Camera);
+
+    if (_LodLevel != (size_t) -1) {
+        sf::Sprite board(_LodTexture);
+        float scale = LodPyramid::span(_LodLevel) * 32.f;
+        board.setPosition(0, _InterfaceOffset);
+        board.setScale(scale, scale);
+        target.draw(board, states);
+    } else if (_Renderer == Renderer::Cached && _CacheValid) {
+        sf::Sprite board(_Cache.getTexture());
+        board.setPosition(0, _InterfaceOffset);
+        target.draw(board, states);
+    } else {
+        states.texture = _Atlas;
+        target.draw(_RenderRegion, states);
+    }
+    target.setView(hud);
+
+    /**
+     * миникарта и рамка того, что сейчас видит камера
+     */
+    auto minimap = _MinimapArea();
+    if (minimap.width != 0 && _MinimapValid) {
+        sf::Sprite overview(_MinimapTexture);
+        overview.setPosition(minimap.left, minimap.top);
+        overview.setScale(minimap.width / _MinimapEdge, minimap.height / _MinimapEdge);
+        target.draw(overview, states);
+
+        float side = _GameMap->size() * 32.f;
+        auto center = _Camera.getCenter(), size = _Camera.getSize();
+        sf::RectangleShape frame(sf::Vector2f(size.x / side * minimap.width, size.y / side * minimap.height));
+        frame.setPosition(minimap.left + (center.x - size.x / 2) / side * minimap.width,
+                          minimap.top + (center.y - size.y / 2 - _InterfaceOffset) / side * minimap.height);
+        frame.setFillColor(sf::Color::Transparent);
+        frame.setOutlineColor(sf::Color::White);
+        frame.setOutlineThickness(1);
+        target.draw(frame, states);
+    }
 
     target.draw(_RemainedLabel, states);
     target.draw(_TimerLabel, states);
@@ -827,3 +1442,35 @@ MenuState::MenuState() {
             })
     };
 }
+
+alone::Coroutine MenuState::onLoad() {
+    auto last = std::make_shared<replay::Replay>();
+    auto snapshot = std::make_shared<save::Snapshot>();
+    auto reading = alone::background([last, snapshot] {
+        return std::make_pair(replay::read(replay::Path, *last) && !last->events.empty(),
+                              save::read(save::Path, *snapshot));
+    });
+    auto [replayed, saved] = co_await reading;
+
+    /**
+     * просмотр последней партии, если она записана
+     */
+    if (replayed) {
+        _Params.insert(_Params.end() - 1, std::make_pair(std::string("Replay"), [last]() {
+            states.insert("game", std::shared_ptr<alone::State>(new GameState(last, 1)));
+            states.erase("menu");
+        }));
+    }
+
+    /**
+     * если есть сохранение, то первой кнопкой идёт продолжение игры
+     */
+    if (saved) {
+        _Params.insert(_Params.begin(), std::make_pair(std::string("Continue"), [snapshot]() {
+            states.insert("game", std::shared_ptr<alone::State>(
+                    new GameState(std::make_unique<save::Snapshot>(std::move(*snapshot)))));
+            states.erase("menu");
+        }));
+    }
+    _Layout();
+}
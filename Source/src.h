@@ -11,12 +11,24 @@
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <algorithm>
+#include <cassert>
+#include <future>
 
 //sfml
 #include <SFML/Graphics.hpp>
 #include <SFML/Audio.hpp>
 
-#define DEBUG_MODE 0
+#include "map.h"
+#include "mesh.h"
+#include "save.h"
+#include "replay.h"
+#include "pregen.h"
+#include "sim.h"
+#include "jobs.h"
+#include "lod.h"
+#include "scheduler.h"
+#include "coroutine.h"
 
 
 namespace alone {
@@ -48,7 +60,7 @@ namespace alone {
      * отвечает за всё в своём процессе
      * наследуется от Drawable, чтобы было меньше кода писать
      */
-    class State : public sf::Drawable {
+    class State : public sf::Drawable, public std::enable_shared_from_this<State> {
         friend class StateMachine;
 
     public:
@@ -58,6 +70,7 @@ namespace alone {
          */
         enum Status {
             OnCreate,
+            Loading,
             Active,
             OnDelete
         };
@@ -73,13 +86,38 @@ namespace alone {
          */
         virtual void onCreate() = 0;
 
+        /**
+         *  тяжёлая часть создания, зовётся сразу после onCreate
+	        может ждать фоновую работу или следующий кадр через co_await, машина продолжает её раз в кадр
+	        пока она не кончилась, состояние не обновляется, а рисуется через drawLoading
+         */
+        virtual Coroutine onLoad() {
+            return {};
+        }
+
+        /**
+         * что рисовать, пока идёт onLoad
+         */
+        virtual void drawLoading(sf::RenderTarget &target, sf::RenderStates states) const {}
+
         /**
          * а этот при удалении
          */
         virtual void onDelete() = 0;
 
+        /**
+         * вызывается, когда закрывают окно, чтобы состояние успело сохраниться
+         */
+        virtual void onClose() {}
+
+        /**
+         * вызывается, когда окну поменяли размер, чтобы состояние сбросило то, что от него зависит
+         */
+        virtual void onResize(sf::Vector2u size) {}
+
     private:
         Status _Status;
+        Coroutine _Loading;
     };
 
     /**
@@ -100,125 +138,108 @@ namespace alone {
 
         void update();
 
+        /**
+         * сообщает всем активным состояниям, что окно закрывается
+         */
+        void close();
+
+        /**
+         * сообщает всем активным состояниям новый размер окна
+         */
+        void resize(sf::Vector2u size);
+
     private:
         std::unordered_map<std::string, std::shared_ptr<State>> _Content;
     };
-}
-
-struct LRMB {
-    bool preLmb = false, nowLmb = false;
-    bool preRmb = false, nowRmb = false;
-};
 
-namespace alone::input {
+    /**
+     *  оверлей производительности в левом нижнем углу, F3 показывает и прячет
+	    время фаз кадра и отложенные задачи планировщика, текст обновляется несколько раз в секунду
+     */
+    class PerfOverlay : public sf::Drawable {
+    public:
+        void update(const FrameScheduler::stats_t &stats);
 
-    void update();
+        bool visible() const {
+            return _Visible;
+        }
 
-    bool isClickedLeftButton();
+    protected:
+        void draw(sf::RenderTarget &target, sf::RenderStates states) const override;
 
-    bool isClickedRightButton();
+    private:
+        bool _Visible = false;
+        sf::Text _Text;
+        sf::RectangleShape _Background;
+        sf::Clock _Refresh;
+    };
 }
 
-//just a crutch for fast naming
-template<class _T>
-using Matrix = std::vector<std::vector<_T>>;
+struct LRMB {
+    bool preLmb = false, nowLmb = false;
+    bool preRmb = false, nowRmb = false;
+    bool preMmb = false, nowMmb = false;
+
+    /**
+     *  обе кнопки зажаты вместе - это аккорд, а не два клика
+	    chording держится, пока не отпущены обе, чтобы отдельные клики не срабатывали
+     */
+    bool chording = false, chordDone = false, chordClick = false, suppress = false;
+};
 
 /**
- * для удобной нумерации текстур
+ * клавиши, нажатые за кадр, приходят из событий окна
  */
-enum class Type {
-    Number1 = 0,
-    Number2 = 1,
-    Number3,
-    Number4,
-    Number5,
-    Number6,
-    Number7,
-    Number8,
-    None,
-    Unknown,
-    Flag,
-    NoBomb,
-    NoneQuiestion,
-    UnknownQuestion,
-    Bomb,
-    RedBomb
+struct Keys {
+    std::vector<sf::Keyboard::Key> pending, now;
 };
 
 /**
- * класс для удобного хранения уровня сложности
+ * прокрутка колеса за кадр, тоже приходит из событий окна
  */
-struct difficulty_t {
+struct Wheel {
+    float pending = 0, now = 0;
+};
 
-    /**
-     * имя уровня сложности
-     */
-    std::string name;
+namespace alone::input {
 
-    /**
-     * количество бомб на карте
-     */
-    size_t bombs;
+    void update();
 
     /**
-     * размер грани карты, карта может быть только квадратная
+     * запоминает нажатую клавишу из события окна
      */
-    size_t size;
-};
+    void press(sf::Keyboard::Key key);
 
-/**
- * класс карты игры
- */
-class Map {
     /**
-     * позволяет работать с картой игры не напрямую
+     * была ли клавиша нажата с прошлого обновления
      */
-    friend class GameState;
-
-public:
+    bool isClickedKey(sf::Keyboard::Key key);
 
     /**
-     *  изменение размера карты игры в зависимости от уровня сложности
+     * запоминает прокрутку колеса из события окна
      */
-
-    void resize(size_t level);
+    void scroll(float delta);
 
     /**
-     *  генерация карты, включая рандомное заполнение
-	    то же берёт заранее заготовленный уровень сложности из std::array <difficulty_t, 3> difficulties
-	    сделано, чтобы игрок не мог проиграть с первого нажатия
-     *  @param point точка, в которую нажал игрок
+     * на сколько прокрутили колесо с прошлого обновления, вверх - больше нуля
      */
-    void generate(size_t level, sf::Vector2u point);
+    float wheel();
 
-    /**
-     * костыль из использования char'а как состояния для отрисовки
-     */
-    //n - unknown, r - revealed, f - flag
-    Matrix<std::pair<char, Type>> _Content;
+    bool isClickedLeftButton();
 
-    /**
-     * кол-во бомб на карте
-     */
-    size_t _Bombs;
+    bool isClickedRightButton();
 
-    /**
-     * проверяет, есть ли бомба по заданному индексу
-     * @return если выходит индекс за пределы карты, то возвращает false
-     */
-    bool _HasBomb(size_t x, size_t y);
+    bool isClickedMiddleButton();
 
     /**
-     * проверяет все клетки сверху, снизу, побокам и по диагонали
+     * аккорд: отпущена средняя кнопка или одна из зажатых вместе левой и правой
      */
-    size_t _DetectAround(size_t x, size_t y);
+    bool isChordClicked();
+}
 
-    /**
-     *  рекурсивный алгоритм, чтобы открыть тайлы вокруг нажатого
-        получается рекурсия только в том случае, если игрок нажимает по пустому тайлу
-     */
-    void _OpenTiles(int x, int y);
-};
+//just a crutch for fast naming
+template<class _T>
+using Matrix = std::vector<std::vector<_T>>;
 
 /**
  *  состояние для меню, чтобы было проще ей управлять
@@ -240,6 +261,18 @@ private:
      */
     void onCreate() override;
 
+    /**
+     * сохранение и повтор читаются с диска в фоне, кнопки для них добавляются, когда чтение кончится
+     */
+    alone::Coroutine onLoad() override;
+
+    /**
+     * пока сохранение читается, кнопки уровней уже видны
+     */
+    void drawLoading(sf::RenderTarget &target, sf::RenderStates states) const override {
+        draw(target, states);
+    }
+
     void onDelete() override;
 
     void draw(sf::RenderTarget &target, sf::RenderStates states = sf::RenderStates::Default) const override;
@@ -252,9 +285,15 @@ private:
     std::vector<sf::Text> _Buttons;
 
     /**
-     * заранее заготовленные параметры для кнопок, создаются в конструкторе
+     * расставляет кнопки по _Params
      */
-    std::array<std::pair<std::string, std::function<void()>>, 4> _Params;
+    void _Layout();
+
+    /**
+     *  заранее заготовленные параметры для кнопок, создаются в конструкторе
+	    вектор, потому что кнопки продолжения и повтора добавляются в onLoad, если есть что читать
+     */
+    std::vector<std::pair<std::string, std::function<void()>>> _Params;
 };
 
 /**
@@ -266,13 +305,16 @@ public:
     /**
      * @param status - это состояние выигрыша
      * @param bombsFound - это количество бомб, которыен нашёл игрок
+     * @param game - законченная игра для кнопки "Play again", без неё кнопки нет
      */
-    GameOverState(bool status, size_t bombsFound) {
+    GameOverState(bool status, size_t bombsFound, std::shared_ptr<alone::State> game = nullptr) {
         _Status = status;
         _BombsFound = bombsFound;
+        _Game = std::move(game);
     }
 
-    sf::Text _Label, _Exit;
+    sf::Text _Label, _Exit, _Again;
+    std::shared_ptr<alone::State> _Game;
     //1 = win, 0 = lose
     bool _Status;
     size_t _BombsFound;
@@ -311,6 +353,24 @@ public:
         _Level = level;
     }
 
+    /**
+     * продолжение сохранённой игры
+     */
+    GameState(std::unique_ptr<save::Snapshot> snapshot) {
+        _Level = snapshot->level;
+        _Resume = std::move(snapshot);
+    }
+
+    /**
+     * просмотр повтора
+     * @param speed во сколько раз быстрее реального времени
+     */
+    GameState(std::shared_ptr<replay::Replay> playback, float speed) {
+        _Level = playback->level;
+        _Playback = std::move(playback);
+        _Speed = speed;
+    }
+
     /**
      * указатель на карту игры
      */
@@ -321,11 +381,6 @@ public:
      */
     const size_t _InterfaceOffset = 100;
 
-    /**
-     * количество заполненных флагов на карте
-     */
-    size_t _Flags = 0;
-
     /**
      * вершины для отрисовки карты
      */
@@ -342,7 +397,8 @@ public:
     size_t _Level;
 
     /**
-     * количество открытых клеток
+     *  количество нажатий, открывавших клетки, идёт в сохранение
+	    началась ли партия, так не узнать: отмена хода его не возвращает, это смотрит _Started по карте
      */
     size_t _Revealed = 0;
 
@@ -351,6 +407,306 @@ public:
      */
     sf::Clock _Clock;
 
+    /**
+     * время, которое уже было наиграно до загрузки сохранения
+     */
+    sf::Time _TimeOffset;
+
+    /**
+     * сохранение, из которого надо продолжить игру, забирается в onCreate
+     */
+    std::unique_ptr<save::Snapshot> _Resume;
+
+    /**
+     * фоновое автосохранение, пока оно не закончилось, новое не запускается
+     */
+    std::future<bool> _Autosave;
+
+    /**
+     * таймер автосохранения
+     */
+    sf::Clock _AutosaveClock;
+
+    /**
+     * были ли ходы после последнего сохранения
+     */
+    bool _Unsaved = false;
+
+    /**
+     * автосохранение стоит в очереди планировщика кадра, второй раз не ставится
+     */
+    bool _AutosaveQueued = false;
+
+    /**
+     *  отложенная задача автосохранения: ждёт, пока симуляция свободна
+	    если партия за это время кончилась или началась заново, ничего не пишет
+     */
+    bool _RunAutosave();
+
+    /**
+     *  ставит метод в очередь планировщика кадра
+	    задача держит состояние слабой ссылкой, если его уже удалили, она просто выкидывается
+     */
+    void _Defer(alone::FrameScheduler::Priority priority, bool (GameState::*task)());
+
+    /**
+     * зерно генерации карты
+     */
+    uint64_t _Seed = 0;
+
+    /**
+     * запись текущей партии
+     */
+    replay::Recorder _Recorder;
+
+    /**
+     * повтор, который сейчас показывается, если nullptr, то играет человек
+     */
+    std::shared_ptr<replay::Replay> _Playback;
+
+    /**
+     * скорость повтора и следующий ход в нём
+     */
+    float _Speed = 1;
+    size_t _Next = 0;
+
+    /**
+     * время внутри повтора, идёт быстрее или медленнее настоящего
+     */
+    sf::Time _PlaybackTime;
+    sf::Clock _PlaybackClock;
+
+    /**
+     *  один ход игрока, одинаково для мышки и для повтора
+	    если запущен поток симуляции, ход уходит туда, иначе применяется сразу
+     */
+    void _Apply(replay::Action action, sf::Vector2u point);
+
+    /**
+     *  сам ход: карта, счётчик нажатий и запись повтора, без надписей и статуса
+	    может идти в потоке симуляции, поэтому трогает только то, что главный поток не трогает, пока она занята
+     *  @param time время хода в миллисекундах для повтора
+     */
+    void _Move(replay::Action action, sf::Vector2u point, uint32_t time);
+
+    /**
+     *  поток симуляции живой игры, в повторе не запускается, там ходы идут по времени записи
+	    пока он занят, update только забирает клетки, рисует и отправляет новые ходы
+     */
+    sim::Thread _Sim;
+
+    /**
+     * клетки, пришедшие из симуляции за кадр, вектор держится, чтобы не выделять память каждый кадр
+     */
+    std::vector<sim::Tile> _Tiles;
+
+    /**
+     *  большая заливка открывается по FloodSlice клеток за шаг, а не за один кадр
+	    в симуляции шаги идут между ходами, в повторе главный поток тратит на них не больше FloodBudget за кадр
+	    в тренировке заливка сразу целиком, иначе её хвост перемешался бы с историей ходов
+     */
+    static constexpr size_t FloodSlice = 4096;
+    static constexpr float FloodBudget = 0.004f;
+
+    /**
+     * кадр симуляции по текущей карте
+     */
+    sim::Frame _SimFrame() const;
+
+    /**
+     * симуляция ещё применяет ходы или карта готовится в фоне, карту трогать нельзя
+     */
+    bool _Busy() const {
+        return _Loading || (_Sim.running() && !_Sim.idle());
+    }
+
+    /**
+     *  как рисуется карта: вершинами каждый кадр или готовой текстурой
+	    во втором случае в текстуру дорисовываются только изменившиеся клетки, а окно рисует один квадрат
+	    F4 переключает, если карта не влезает в текстуру видеокарты, остаются вершины
+     */
+    enum class Renderer {
+        Vertices,
+        Cached
+    };
+    Renderer _Renderer = Renderer::Vertices;
+
+    /**
+     * карта в пикселях, без интерфейса
+     */
+    sf::RenderTexture _Cache;
+
+    /**
+     * false - кэш надо перерисовать целиком: новая карта, другой размер окна
+     */
+    bool _CacheValid = false;
+
+    /**
+     * клетки, изменившиеся за кадр, и их квадраты для дорисовки в кэш
+     */
+    std::vector<size_t> _Changed;
+    sf::VertexArray _Patch = sf::VertexArray(sf::Quads);
+
+    /**
+     * дорисовывает изменения в кэш или перерисовывает его целиком
+     */
+    void _UpdateCache();
+
+    /**
+     *  камера карты: колесо мыши приближает к точке под курсором
+	    интерфейс рисуется без неё, поэтому надписи не двигаются
+     */
+    sf::View _Camera;
+
+    /**
+     * во сколько раз мир больше экрана, 1 - клетка 32 пикселя, больше - карта дальше
+     */
+    float _Zoom = 1;
+
+    /**
+     * камера на всю карту в масштабе 1
+     */
+    void _ResetCamera();
+
+    /**
+     * размер и место камеры по размеру окна и масштабу, центр не меняется
+     */
+    void _FitCamera();
+
+    /**
+     *  карта издалека: когда клетка меньше LodPixels пикселей, рисуется маленькая текстура
+	    из уровня пирамиды, где квадрат примерно в пиксель, а не миллионы квадратов атласа
+     */
+    static constexpr float LodPixels = 2;
+    LodPyramid _Lod;
+    bool _LodValid = false;
+
+    /**
+     * изменения копятся, пока симуляция занята, пирамида читает карту только когда та свободна
+     */
+    std::vector<size_t> _LodPending;
+
+    /**
+     * текстура уровня _LodLevel и её пиксели, _LodLevel == -1 - текстуры нет
+     */
+    sf::Texture _LodTexture;
+    std::vector<sf::Uint8> _LodPixels;
+    size_t _LodLevel = -1;
+
+    /**
+     * какой уровень пирамиды рисовать при текущем масштабе, levels() - рисовать клетки
+     */
+    size_t _LodLevelFor() const;
+
+    /**
+     * догоняет пирамиду и текстуру по накопленным изменениям
+     */
+    void _UpdateLod();
+
+    /**
+     *  миникарта справа от надписей: пиксель на клетку, а у больших карт - на квадрат пирамиды
+	    обновляется из тех же изменений, что и пирамида, в текстуру заливаются только изменившиеся строки
+	    нажатие по ней переносит камеру в эту точку
+     */
+    static constexpr float MinimapSide = 80;
+    static constexpr size_t MinimapTiles = 512;
+    sf::Texture _MinimapTexture;
+    std::vector<sf::Uint8> _MinimapPixels;
+    size_t _MinimapEdge = 0;
+    bool _MinimapValid = false;
+
+    /**
+     * изменившиеся точки миникарты, копятся до отложенной перерисовки
+     */
+    std::vector<size_t> _MinimapPending;
+    bool _MinimapQueued = false;
+
+    /**
+     *  уровень пирамиды для миникарты, -1 - пиксель на клетку
+     *  @param edge сюда пишется сторона миникарты в точках
+     */
+    size_t _MinimapLevel(size_t &edge) const;
+
+    /**
+     * где миникарта в окне, пустой прямоугольник - места рядом с надписями нет
+     */
+    sf::FloatRect _MinimapArea() const;
+
+    /**
+     * вызывается из _UpdateLod, пока изменения ещё не сброшены, и ставит перерисовку миникарты в очередь
+     */
+    void _QueueMinimap();
+
+    /**
+     *  отложенная перерисовка миникарты в остатке кадра
+	    клетки читаются из карты, поэтому, пока симуляция занята, задача ждёт
+     */
+    bool _UpdateMinimap();
+
+    /**
+     * забирает из симуляции клетки в вершины и последний кадр в статус и надпись
+     */
+    void _SyncSim();
+
+    /**
+     * новая партия без пересоздания состояния, карты, вершин и надписей
+     */
+    void _Restart();
+
+    /**
+     *  карта нужного уровня для новой партии, ничего кроме map не трогает, так что идёт и в фоне
+     *  @return зерно карты для повтора
+     */
+    static uint64_t _PrepareBoard(Map &map, size_t level, const replay::Replay *playback);
+
+    /**
+     * всё остальное от _Restart: счётчики, таймеры, продолжение сохранения и надписи, только в главном потоке
+     */
+    void _StartGame(uint64_t seed);
+
+    /**
+     * onLoad готовит карту в фоне, до конца этого её никто, кроме фона, не трогает
+     */
+    bool _Loading = false;
+
+    /**
+     *  режим тренировки, ходы можно отменять
+	    такие партии не сохраняются и не пишутся в повтор
+     */
+    bool _Training = false;
+
+    /**
+     * переключение тренировки и отмена/возврат ходов
+     */
+    void _UpdateTraining();
+
+    /**
+     * статус игры по счётчикам карты, сам _GameStatus не меняет, чтобы его можно было звать из симуляции
+     */
+    char _EndStatus() const;
+
+    /**
+     *  было ли первое нажатие: на карте открыта хоть одна клетка или идёт заливка, за O(1) по счётчикам
+	    после отмены всех ходов снова false, и следующее нажатие опять первое
+     */
+    bool _Started() const;
+
+    /**
+     * применяет ходы повтора, время которых уже пришло
+     */
+    void _UpdatePlayback();
+
+    /**
+     * счётчики текущей игры для сохранения
+     */
+    save::Progress _Progress() const;
+
+    /**
+     *  запускает запись сохранения в отдельном потоке
+	    в главном потоке карта только кодируется в байты, в фоне идёт запись файла
+     */
+    void _StartAutosave();
+
     /**
      * две надписи с прошедшим временем после начала игры и количеством оставшихся бомб
      */
@@ -358,12 +714,35 @@ public:
     //a - active, w - win, l - lose
     char _GameStatus = 'a';
 
+    /**
+     * надпись, пока карта готовится
+     */
+    sf::Text _LoadingLabel;
+
     void update() override;
 
     void onCreate() override;
 
+    /**
+     *  карта выделяется и генерируется в фоне, окно в это время рисует надпись загрузки
+	    потом в главном потоке запускается симуляция и окно меняет размер
+     */
+    alone::Coroutine onLoad() override;
+
+    void drawLoading(sf::RenderTarget &target, sf::RenderStates states) const override;
+
     void onDelete() override;
 
+    /**
+     * при закрытии окна незаконченная игра сохраняется
+     */
+    void onClose() override;
+
+    /**
+     * новый размер окна - кэш карты перерисовывается целиком
+     */
+    void onResize(sf::Vector2u size) override;
+
     void draw(sf::RenderTarget &target, sf::RenderStates states = sf::RenderStates::Default) const override;
 };
 
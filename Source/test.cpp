@@ -1,5 +1,14 @@
 #include <doctest.h>
 #include "src.h"
+#include "fixed_map.h"
+#include "corpus.h"
+#include "codec.h"
+#include "replay.h"
+#include "jobs.h"
+#include "sim.h"
+#include "lod.h"
+#include "scheduler.h"
+#include "coroutine.h"
 
 namespace alone::input {
     bool preLmb = false, nowLmb = false;
@@ -28,6 +37,24 @@ namespace alone::input {
                 CHECK(dif.bombs != 0);
     }
 
+    TEST_CASE ("Testing unbiased Random::upTo.")
+    {
+        Random rng(12);
+        for (uint64_t n: {uint64_t(0), uint64_t(1), uint64_t(6), uint64_t(1000), UINT64_MAX - 1, UINT64_MAX})
+            for (int i = 0; i != 100; i++)
+                        CHECK(rng.upTo(n) <= n);
+
+        /**
+         *  при n + 1 = 3 * 2^62 остаток от деления дал бы первой трети половину всех чисел
+         */
+        uint64_t n = (3ull << 62) - 1;
+        size_t first = 0, total = 30000;
+        for (size_t i = 0; i != total; i++)
+            first += rng.upTo(n) < (1ull << 62);
+                CHECK(first > total * 3 / 10);
+                CHECK(first < total * 37 / 100);
+    }
+
     TEST_CASE ("Testing method has_bombs.")
     {
         Map m;
@@ -41,4 +68,1069 @@ namespace alone::input {
         g.onDelete();
                 REQUIRE(g._GameMap == nullptr);
     }
-}
\ No newline at end of file
+
+    TEST_CASE ("Testing restart in place.")
+    {
+        GameState g(2);
+        g._GameMap.reset(new Map());
+        g._GameMap->resize(2);
+        g._Restart();
+                REQUIRE(g._GameMap->mines().size() == 70);
+
+        auto data = g._GameMap->_Content.data();
+        g._GameMap->makeSafe(sf::Vector2u(3, 3), 1);
+        g._GameMap->reveal(3, 3);
+        g._Revealed = 1;
+
+        /**
+         * новая партия идёт в ту же память
+         */
+        g._Restart();
+                CHECK(g._Revealed == 0);
+                CHECK(g._GameStatus == 'a');
+                CHECK(g._GameMap->_Content.data() == data);
+                CHECK(g._GameMap->hiddenSafe() == 330);
+    }
+
+    TEST_CASE ("Testing undo back to the first click.")
+    {
+        GameState g(2);
+        g._Training = true;
+        g._GameMap.reset(new Map());
+        g._Restart();
+        auto &map = *g._GameMap;
+                REQUIRE(map.history());
+                CHECK_FALSE(g._Started());
+
+        g._Move(replay::Action::Left, sf::Vector2u(3, 3), 0);
+                REQUIRE(g._Started());
+
+        /**
+         * после отмены первого хода карта снова целиком закрыта, и следующий клик опять первый
+         */
+                REQUIRE(map.undo());
+                CHECK_FALSE(g._Started());
+
+        size_t mine = map.mines().front();
+        sf::Vector2u bomb(mine % 20, mine / 20);
+        g._Move(replay::Action::Right, bomb, 1);
+                CHECK(map.at(bomb.x, bomb.y).first == 'n');
+        g._Move(replay::Action::Left, bomb, 2);
+                CHECK(map.exploded() == 0);
+                CHECK(g._Started());
+                CHECK(g._EndStatus() == 'a');
+    }
+
+    TEST_CASE ("Testing tiled layout.")
+    {
+        Map rows, tiles;
+        rows.resize(20, Map::Layout::RowMajor);
+        tiles.resize(20, Map::Layout::Tiled);
+        rows.generate(70, sf::Vector2u(3, 5), 7);
+        tiles.generate(70, sf::Vector2u(3, 5), 7);
+
+        size_t bombs = 0;
+        for (size_t y = 0; y != 20; y++)
+            for (size_t x = 0; x != 20; x++) {
+                        REQUIRE(rows.at(x, y) == tiles.at(x, y));
+                bombs += rows._HasBomb(x, y);
+            }
+                CHECK(bombs == 70);
+                CHECK(rows._HasBomb(3, 5) == false);
+
+        size_t summary = 0;
+        for (size_t by = 0; by != tiles.blocks(); by++) {
+            for (size_t bx = 0; bx != tiles.blocks(); bx++)
+                summary += tiles.block(bx, by).bombs;
+        }
+                CHECK(summary == 70);
+
+        tiles._OpenTiles(3, 5);
+                CHECK(tiles._BlockHidden(0, 0) == false);
+    }
+
+    TEST_CASE ("Testing FixedMap matches Map.")
+    {
+        Map map;
+        HardMap fixed;
+        map.resize(2);
+        map.generate(70, sf::Vector2u(10, 10), 123);
+        fixed.generate(sf::Vector2u(10, 10), 123);
+
+        for (size_t y = 0; y != 20; y++)
+            for (size_t x = 0; x != 20; x++)
+                        REQUIRE(map.at(x, y) == fixed.at(x, y));
+
+        map._OpenTiles(10, 10);
+        fixed._OpenTiles(10, 10);
+        for (size_t y = 0; y != 20; y++)
+            for (size_t x = 0; x != 20; x++)
+                        REQUIRE(map.at(x, y).first == fixed.at(x, y).first);
+                CHECK(map.hiddenSafe() == fixed.hiddenSafe());
+    }
+
+    TEST_CASE ("Testing corpus records.")
+    {
+        corpus::Header header;
+        header.size = 8;
+        header.bombs = 10;
+        header.seed = 5;
+        header.flags = corpus::FirstClick | corpus::Seed;
+                REQUIRE(corpus::recordSize(header) == 8 + 8 + 8);
+
+        Map map;
+        uint64_t seed;
+        auto first = corpus::generate(map, header, 3, seed);
+        std::vector<uint8_t> record(corpus::recordSize(header));
+        corpus::encode(header, map, first, seed, record.data());
+
+        size_t bombs = 0;
+        for (size_t bit = 0; bit != 64; bit++) {
+            bool bomb = record[16 + bit / 8] >> (bit % 8) & 1;
+                    CHECK(bomb == map._HasBomb(bit % 8, bit / 8));
+            bombs += bomb;
+        }
+                CHECK(bombs == 10);
+
+        Map again;
+        again.resize(8, Map::Layout::RowMajor);
+        again.generate(10, first, seed);
+        for (size_t bit = 0; bit != 64; bit++)
+                    REQUIRE(again._HasBomb(bit % 8, bit / 8) == map._HasBomb(bit % 8, bit / 8));
+    }
+
+    TEST_CASE ("Testing mapped corpus.")
+    {
+        corpus::Header header;
+        header.size = 10;
+        header.bombs = 20;
+        header.count = 4;
+        header.flags = corpus::FirstClick | corpus::Seed;
+
+        std::string path = "test_corpus.bin";
+                REQUIRE(corpus::create(path, header));
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            std::vector<uint8_t> record(corpus::recordSize(header));
+            Map map;
+            for (uint64_t i = 0; i != header.count; i++) {
+                uint64_t seed;
+                auto first = corpus::generate(map, header, i, seed);
+                corpus::encode(header, map, first, seed, record.data());
+                file.seekp(corpus::recordOffset(header, i));
+                file.write((const char *) record.data(), record.size());
+            }
+        }
+
+        corpus::File file;
+                REQUIRE(file.open(path));
+                REQUIRE(file.count() == 4);
+
+        for (size_t i = 0; i != file.count(); i++) {
+            Map expected, loaded;
+            uint64_t seed;
+            auto first = corpus::generate(expected, header, i, seed);
+
+            auto view = file[i];
+                    CHECK(view.firstClick() == first);
+                    CHECK(view.seed() == seed);
+
+                    REQUIRE(view.load(loaded));
+            for (size_t y = 0; y != 10; y++)
+                for (size_t x = 0; x != 10; x++)
+                            REQUIRE(loaded.at(x, y) == expected.at(x, y));
+        }
+        file.prefetch(2, 100);
+        file.prefetch(10, 1);
+
+                CHECK(file.at(3).has_value());
+                CHECK_FALSE(file.at(4).has_value());
+
+        /**
+         * испорченная запись индекса ловится при обращении, огромное количество в заголовке не открывается
+         */
+        file.close();
+        auto corrupt = [&](uint64_t offset, uint64_t value) {
+            std::fstream raw(path, std::ios::binary | std::ios::in | std::ios::out);
+            raw.seekp(offset);
+            raw.write((const char *) &value, sizeof(value));
+        };
+        corrupt(sizeof(corpus::Header) + 2 * sizeof(uint64_t), 1ull << 40);
+                REQUIRE(file.open(path));
+                CHECK_FALSE(file.at(2).has_value());
+                CHECK(file.at(1).has_value());
+        file.prefetch(0, 4);
+        file.close();
+        corrupt(sizeof(corpus::Header) + 2 * sizeof(uint64_t), corpus::recordOffset(header, 2));
+                REQUIRE(file.open(path));
+                CHECK(file.at(2).has_value());
+        file.close();
+
+        /**
+         *  10 x 10 - это 100 бит в 13 байтах, старший бит последнего байта - клетка номер 103
+	        такая маска не должна попасть в place
+         */
+        {
+            std::fstream raw(path, std::ios::binary | std::ios::in | std::ios::out);
+            raw.seekp(corpus::recordOffset(header, 1) + corpus::recordSize(header) - 1);
+            raw.put((char) 0x80);
+        }
+                REQUIRE(file.open(path));
+        {
+            Map loaded;
+                    CHECK_FALSE(file[1].load(loaded));
+                    CHECK(loaded.size() != 10);
+                    CHECK(file[0].load(loaded));
+        }
+        file.close();
+        corrupt(offsetof(corpus::Header, count), 1ull << 61);
+                CHECK(file.open(path) == false);
+
+        std::remove(path.c_str());
+                CHECK(file.open(path) == false);
+    }
+
+    TEST_CASE ("Testing codec round trip.")
+    {
+        for (auto layout: {Map::Layout::RowMajor, Map::Layout::Tiled}) {
+            Map map;
+            map.resize(37, layout);
+            map.generate(200, sf::Vector2u(4, 4), 99);
+            map._OpenTiles(4, 4);
+            map._SetState(0, 36, 'f');
+            map._SetState(36, 36, 'f');
+            map._SetState(20, 0, 'r');
+
+            std::vector<uint8_t> data;
+            codec::encode(map, data);
+                    CHECK(data.size() < 37 * 37 / 2);
+
+            Map loaded;
+            loaded.resize(1, layout);
+            const uint8_t *it = data.data();
+                    REQUIRE(codec::decode(it, data.data() + data.size(), loaded));
+                    CHECK(it == data.data() + data.size());
+                    REQUIRE(loaded.size() == 37);
+            for (size_t y = 0; y != 37; y++)
+                for (size_t x = 0; x != 37; x++)
+                            REQUIRE(loaded.at(x, y) == map.at(x, y));
+
+            /**
+             * обрезанные данные должны отвергаться
+             */
+            it = data.data();
+                    CHECK(codec::decode(it, data.data() + data.size() - 1, loaded) == false);
+        }
+
+        /**
+         * огромная грань отвергается до выделения памяти под карту
+         */
+        std::vector<uint8_t> hostile;
+        codec::putVarint(hostile, 1 << 24);
+        codec::putVarint(hostile, 0);
+        Map loaded;
+        const uint8_t *it = hostile.data();
+                CHECK(codec::decode(it, hostile.data() + hostile.size(), loaded) == false);
+                CHECK(loaded.size() == 0);
+    }
+
+    TEST_CASE ("Testing save snapshot.")
+    {
+        save::Snapshot snapshot;
+        snapshot.level = 1;
+        snapshot.revealed = 4;
+        snapshot.remained = 17;
+        snapshot.elapsed = 123456;
+        snapshot.map.resize(1);
+        snapshot.map.generate(20, sf::Vector2u(1, 1), 8);
+        snapshot.map._OpenTiles(1, 1);
+        size_t mine = snapshot.map.mines().front();
+        snapshot.map._SetState(mine % 10, mine / 10, 'f');
+                REQUIRE(snapshot.map.correctFlags() == 1);
+
+        std::string path = "test_save.dat";
+                REQUIRE(save::write(path, snapshot));
+
+        save::Snapshot loaded;
+                REQUIRE(save::read(path, loaded));
+                CHECK(loaded.level == 1);
+                CHECK(loaded.map.correctFlags() == 1);
+                CHECK(loaded.revealed == 4);
+                CHECK(loaded.remained == 17);
+                CHECK(loaded.elapsed == 123456);
+        for (size_t y = 0; y != 10; y++)
+            for (size_t x = 0; x != 10; x++)
+                        REQUIRE(loaded.map.at(x, y) == snapshot.map.at(x, y));
+
+        /**
+         * автосохранение кодирует счётчики и карту без копии карты, файл тот же
+         */
+        std::vector<uint8_t> data;
+        save::encode(snapshot, snapshot.map, data);
+        std::ifstream file(path, std::ios::binary);
+        std::vector<uint8_t> written((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        file.close();
+                CHECK(written == data);
+
+        std::remove(path.c_str());
+                CHECK(save::read(path, loaded) == false);
+    }
+
+    TEST_CASE ("Testing replay record and playback.")
+    {
+        Map expected;
+        expected.resize(2);
+        expected.generate(70, 77);
+        expected.makeSafe(sf::Vector2u(5, 5), 78);
+
+        std::string path = "test.replay";
+        {
+            replay::Recorder recorder;
+            recorder.start(path, 2, 77, sf::Vector2u(5, 5));
+            recorder.append({0, replay::Action::Left, 5, 5});
+            expected.reveal(5, 5);
+
+            /**
+             * флаги на все бомбы и открытие безопасных клеток первой строки
+             */
+            uint32_t time = 10;
+            for (size_t y = 0; y != 20; y++)
+                for (size_t x = 0; x != 20; x++) {
+                    if (expected._HasBomb(x, y)) {
+                        recorder.append({time += 3, replay::Action::Right, (uint32_t) x, (uint32_t) y});
+                        expected.toggleFlag(x, y);
+                    } else if (y == 0) {
+                        recorder.append({time += 3, replay::Action::Left, (uint32_t) x, (uint32_t) y});
+                        expected.reveal(x, y);
+                    }
+                }
+        }
+
+        replay::Replay loaded;
+                REQUIRE(replay::read(path, loaded));
+                CHECK(loaded.level == 2);
+                CHECK(loaded.seed == 77);
+                CHECK(loaded.first == sf::Vector2u(5, 5));
+                REQUIRE(loaded.events.size() > 70);
+                CHECK(loaded.events[1].time == 13);
+
+        Map played;
+                CHECK(replay::play(loaded, played) == loaded.events.size());
+        for (size_t y = 0; y != 20; y++)
+            for (size_t x = 0; x != 20; x++)
+                        REQUIRE(played.at(x, y) == expected.at(x, y));
+
+        /**
+         * ход за краем карты обрывает повтор, а первое нажатие за краем - весь файл
+         */
+        {
+            replay::Recorder recorder;
+            recorder.start(path, 2, 77, sf::Vector2u(5, 5));
+            recorder.append({0, replay::Action::Left, 5, 5});
+            recorder.append({5, replay::Action::Right, 20, 3});
+            recorder.append({9, replay::Action::Right, 3, 3});
+        }
+                REQUIRE(replay::read(path, loaded));
+                CHECK(loaded.events.size() == 1);
+        {
+            replay::Recorder recorder;
+            recorder.start(path, 2, 77, sf::Vector2u(5, 1u << 20));
+        }
+                CHECK_FALSE(replay::read(path, loaded));
+
+        std::remove(path.c_str());
+    }
+
+    TEST_CASE ("Testing chord and dirty tiles.")
+    {
+        Map map;
+        map.resize(0);
+        map.place({1});
+
+        map.reveal(1, 1);
+                REQUIRE(map.at(1, 1) == Map::Tile('r', Type::Number1));
+
+        /**
+         * без флага аккорд ничего не делает
+         */
+                CHECK_FALSE(map.chord(1, 1));
+                CHECK(map.at(0, 0).first == 'n');
+
+        sf::VertexArray region(sf::Quads);
+        buildMesh(map, region, 100);
+
+        map.toggleFlag(1, 0);
+        map.clearDirty();
+                CHECK_FALSE(map.chord(1, 1));
+                CHECK(map.dirty().size() == 62);
+        for (size_t y = 0; y != 8; y++)
+            for (size_t x = 0; x != 8; x++)
+                        CHECK(map.at(x, y).first == (x == 1 && y == 0 ? 'f' : 'r'));
+
+        /**
+         * обновление по изменённым клеткам даёт те же вершины, что и полная перестройка
+         */
+        region[4 * 1].texCoords = sf::Vector2f(0, 0);
+        updateMesh(map, region, {1});
+        updateMesh(map, region, map.dirty());
+        sf::VertexArray expected(sf::Quads);
+        buildMesh(map, expected, 100);
+        for (size_t i = 0; i != expected.getVertexCount(); i++)
+                    REQUIRE(region[i].texCoords == expected[i].texCoords);
+
+        /**
+         * сборка по строкам в пуле и перестройка одних текстур дают те же вершины
+         */
+        alone::JobSystem jobs(2);
+        sf::VertexArray pooled(sf::Quads);
+        buildMesh(map, pooled, 100, jobs);
+        map.toggleFlag(1, 0);
+        buildMesh(map, expected, 100);
+        retextureMesh(map, pooled, jobs);
+                REQUIRE(pooled.getVertexCount() == expected.getVertexCount());
+        for (size_t i = 0; i != expected.getVertexCount(); i++) {
+                    REQUIRE(pooled[i].position == expected[i].position);
+                    REQUIRE(pooled[i].texCoords == expected[i].texCoords);
+        }
+
+        /**
+         * флаг не на бомбе - аккорд открывает бомбу
+         */
+        map.resize(0);
+        map.place({1});
+        map.reveal(0, 1);
+        map.toggleFlag(0, 0);
+                CHECK(map.chord(0, 1));
+                CHECK(map.at(1, 0).first == 'r');
+    }
+
+    TEST_CASE ("Testing end of game counters.")
+    {
+        Map map;
+        map.resize(2);
+        map.generate(70, sf::Vector2u(0, 0), 5);
+                CHECK(map.hiddenSafe() == 330);
+
+        /**
+         * счётчики сверяются с полным проходом по карте после каждого хода
+         */
+        auto scan = [&map](size_t &hidden, size_t &correct, size_t &wrong) {
+            hidden = correct = wrong = 0;
+            for (size_t y = 0; y != 20; y++)
+                for (size_t x = 0; x != 20; x++) {
+                    auto &tile = map.at(x, y);
+                    hidden += tile.first != 'r' && tile.second != Type::Bomb;
+                    correct += tile.first == 'f' && tile.second == Type::Bomb;
+                    wrong += tile.first == 'f' && tile.second != Type::Bomb;
+                }
+        };
+
+        Random rng(9);
+        size_t hidden, correct, wrong;
+        for (size_t i = 0; i != 300 && map.hiddenSafe() != 0; i++) {
+            size_t x = rng.upTo(19), y = rng.upTo(19);
+            if (rng.upTo(3) == 0 || map._HasBomb(x, y))
+                map.toggleFlag(x, y);
+            else
+                map.reveal(x, y);
+
+            scan(hidden, correct, wrong);
+                    REQUIRE(map.hiddenSafe() == hidden);
+                    REQUIRE(map.correctFlags() == correct);
+                    REQUIRE(map.wrongFlags() == wrong);
+        }
+                CHECK(map.exploded() == 0);
+
+        /**
+         * снятие всех флагов и открытие всего безопасного - выигрыш
+         */
+        for (size_t y = 0; y != 20; y++)
+            for (size_t x = 0; x != 20; x++) {
+                if (map.at(x, y).first == 'f')
+                    map.toggleFlag(x, y);
+                if (!map._HasBomb(x, y))
+                    map.reveal(x, y);
+            }
+                CHECK(map.hiddenSafe() == 0);
+                CHECK(map.correctFlags() + map.wrongFlags() == 0);
+
+        map.reveal(map.mines()[0] % 20, map.mines()[0] / 20);
+                CHECK(map.exploded() == 1);
+    }
+
+    TEST_CASE ("Testing mine relocation.")
+    {
+        Map map, expected;
+        map.resize(2);
+        expected.resize(2);
+        map.generate(70, 31);
+
+        /**
+         * после любого переноса числа совпадают с картой, посчитанной с нуля
+         */
+        Random rng(4);
+        for (size_t i = 0; i != 200; i++) {
+            size_t to = rng.upTo(399);
+            if (!map._HasBomb(to % 20, to / 20))
+                map.moveMine(rng.upTo(69), to);
+        }
+        expected.place(map.mines());
+        for (size_t y = 0; y != 20; y++)
+            for (size_t x = 0; x != 20; x++)
+                        REQUIRE(map.at(x, y) == expected.at(x, y));
+
+        /**
+         * первое нажатие с гарантированной областью
+         */
+        size_t first = map.mines()[0];
+        sf::Vector2u point(first % 20, first / 20);
+                REQUIRE(map.makeSafe(point, 1, true));
+                CHECK(map.at(point.x, point.y).second == Type::None);
+                CHECK(map.mines().size() == 70);
+                CHECK(map.hiddenSafe() == 330);
+
+        /**
+         * если места нет, карта не меняется
+         */
+        map.resize(0);
+        map.generate(63, 2);
+                CHECK_FALSE(map.makeSafe(sf::Vector2u(3, 3), 1, true));
+                CHECK(map.makeSafe(sf::Vector2u(3, 3), 1));
+                CHECK(map.at(3, 3).second != Type::Bomb);
+    }
+
+    TEST_CASE ("Testing background board queue.")
+    {
+        pregen::Worker worker;
+        pregen::Ready ready;
+                CHECK_FALSE(worker.take(0, ready));
+
+        worker.start();
+        for (size_t level = 0; level != difficulties.size(); level++)
+            while (worker.ready(level) != pregen::Depth)
+                std::this_thread::yield();
+                REQUIRE(worker.take(1, ready));
+        worker.stop();
+
+                CHECK(ready.map.size() == difficulties[1].size);
+                CHECK(ready.map.mines().size() == difficulties[1].bombs);
+
+        /**
+         * карта из очереди та же, что генерируется по её зерну
+         */
+        Map expected;
+        expected.resize(1);
+        expected.generate(difficulties[1].bombs, ready.seed);
+        for (size_t y = 0; y != expected.size(); y++)
+            for (size_t x = 0; x != expected.size(); x++)
+                        REQUIRE(ready.map.at(x, y) == expected.at(x, y));
+
+        /**
+         * отданная обратно карта становится следующей заготовкой, память та же
+         */
+        auto data = ready.map._Content.data();
+        worker.recycle(std::move(ready.map));
+        worker.start();
+        while (worker.ready(1) != pregen::Depth)
+            std::this_thread::yield();
+        worker.stop();
+        bool reused = false;
+        while (worker.take(1, ready))
+            reused |= ready.map._Content.data() == data;
+                CHECK(reused);
+    }
+
+    TEST_CASE ("Testing undo and redo.")
+    {
+        Map map, expected;
+        map.resize(512, Map::Layout::Tiled);
+        map.generate(512 * 512 / 10, 12);
+        map.makeSafe(sf::Vector2u(256, 256), 13, true);
+        map.setHistory(true);
+
+        /**
+         * большой обход и несколько мелких ходов
+         */
+        map.beginMove();
+        map.reveal(256, 256);
+        expected = map;
+                REQUIRE(map.hiddenSafe() < 512 * 512 - 512 * 512 / 10);
+
+        Random rng(6);
+        for (size_t i = 0; i != 10000; i++) {
+            size_t x = rng.upTo(511), y = rng.upTo(511);
+            map.beginMove();
+            if (map._HasBomb(x, y))
+                map.toggleFlag(x, y);
+            else
+                map.reveal(x, y);
+        }
+
+        /**
+         * 10000 ходов укладываются в несколько размеров карты
+         */
+                CHECK(map.historyBytes() < 4 * 512 * 512 * sizeof(Map::Tile));
+
+        Map last = map;
+        while (map.hiddenSafe() != expected.hiddenSafe() || map.correctFlags() != 0)
+                    REQUIRE(map.undo());
+        for (size_t y = 0; y != 512; y++)
+            for (size_t x = 0; x != 512; x++)
+                        REQUIRE(map.at(x, y) == expected.at(x, y));
+
+        while (map.redo()) {}
+                CHECK(map.hiddenSafe() == last.hiddenSafe());
+                CHECK(map.correctFlags() == last.correctFlags());
+        for (size_t y = 0; y != 512; y++)
+            for (size_t x = 0; x != 512; x++)
+                        REQUIRE(map.at(x, y) == last.at(x, y));
+
+        /**
+         * отмена первого хода закрывает всю область обхода
+         */
+        while (map.undo()) {}
+                CHECK(map.hiddenSafe() == 512 * 512 - 512 * 512 / 10);
+                CHECK(map.block(32, 32).revealed == 0);
+    }
+
+    TEST_CASE ("Testing parallel generation.")
+    {
+        Map one, many, expected;
+        one.resize(1000, Map::Layout::RowMajor);
+        many.resize(1000, Map::Layout::Tiled);
+        alone::JobSystem serial(0), pool(4);
+        one.generate(200000, 21, serial);
+        many.generate(200000, 21, pool);
+
+        /**
+         * карта не зависит ни от количества потоков, ни от раскладки
+         */
+                REQUIRE(one.mines().size() == 200000);
+                CHECK(one.mines() == many.mines());
+                CHECK(one.hiddenSafe() == 800000);
+
+        /**
+         * числа на стыках полос совпадают с посчитанными с нуля
+         */
+        expected.resize(1000, Map::Layout::RowMajor);
+        expected.place(one.mines());
+        for (size_t y = 0; y != 1000; y++)
+            for (size_t x = 0; x != 1000; x++)
+                        REQUIRE(many.at(x, y) == expected.at(x, y));
+
+        /**
+         * доли полос близки к ожидаемым: 256 строк из 1000 - около четверти бомб
+         */
+        size_t first = std::count_if(one.mines().begin(), one.mines().end(), [](size_t pos) {
+            return pos < 256 * 1000;
+        });
+                CHECK(first > 50000);
+                CHECK(first < 52400);
+    }
+
+    TEST_CASE ("Testing job system.")
+    {
+        /**
+         * с нулём потоков всё идёт по порядку в вызывающем потоке
+         */
+        alone::JobSystem none(0);
+        std::vector<size_t> order;
+        auto caller = std::this_thread::get_id();
+        none.parallelFor(0, 10, 3, [&](size_t from, size_t to) {
+            order.push_back(from);
+                    CHECK(std::this_thread::get_id() == caller);
+        });
+                CHECK(order == std::vector<size_t>{0, 3, 6, 9});
+
+        /**
+         * каждый индекс обрабатывается ровно один раз, в том числе из вложенных задач
+         */
+        alone::JobSystem jobs(3);
+        std::vector<std::atomic<int>> hits(10000);
+        jobs.parallelFor(0, hits.size(), 7, [&](size_t from, size_t to) {
+            jobs.parallelFor(from, to, 1, [&](size_t a, size_t b) {
+                for (size_t i = a; i != b; i++)
+                    hits[i]++;
+            });
+        });
+                CHECK(std::all_of(hits.begin(), hits.end(), [](auto &it) {
+                    return it == 1;
+                }));
+
+        /**
+         * после отмены не начатые задачи пропускаются, а wait всё равно возвращается
+         */
+        std::atomic<size_t> done = 0;
+        alone::TaskGroup group(jobs);
+        group.cancel();
+        for (size_t i = 0; i != 100; i++)
+            group.run([&] {
+                done++;
+            });
+        group.wait();
+                CHECK(group.cancelled());
+                CHECK(done == 0);
+    }
+
+    TEST_CASE ("Testing simulation thread.")
+    {
+        /**
+         * очередь между двумя потоками не теряет и не переставляет элементы
+         */
+        auto queue = std::make_unique<alone::SpscQueue<size_t, 64>>();
+        std::thread writer([&] {
+            for (size_t i = 0; i != 100000; i++)
+                while (!queue->push(i))
+                    std::this_thread::yield();
+        });
+        size_t expected = 0, value;
+        bool ordered = true;
+        while (expected != 100000)
+            if (queue->pop(value))
+                ordered &= value == expected++;
+        writer.join();
+                CHECK(ordered);
+                CHECK(queue->empty());
+
+        /**
+         * ход применяется в потоке симуляции, а клетки приходят в главный уже с картинками
+         */
+        Map map, expected_map;
+        map.resize(64, Map::Layout::Tiled);
+        map.generate(300, 4);
+        map.makeSafe(sf::Vector2u(30, 30), 5, true);
+        expected_map = map;
+        expected_map.reveal(30, 30);
+        map.clearDirty();
+
+        /**
+         * заливка идёт кусками по 64 клетки, idle только после последнего
+         */
+        map.setProgressive(true);
+        auto frameOf = [&] {
+            return sim::Frame{map._Bombs, map.exploded() ? 'l' : 'a', map.flooding()};
+        };
+        sim::Thread thread;
+        thread.start(map, [&](const sim::Move &move) {
+            map.reveal(move.x, move.y);
+            return frameOf();
+        }, [&] {
+            map.step(64);
+            return frameOf();
+        });
+        thread.push({replay::Action::Left, 30, 30, 0});
+
+        std::vector<sim::Tile> tiles, all;
+        while (!thread.idle()) {
+            thread.drain(tiles);
+            all.insert(all.end(), tiles.begin(), tiles.end());
+        }
+        thread.drain(tiles);
+        all.insert(all.end(), tiles.begin(), tiles.end());
+
+        sim::Frame frame;
+                REQUIRE(thread.frame(frame));
+                CHECK(frame.status == 'a');
+                CHECK_FALSE(frame.working);
+                CHECK(!thread.frame(frame));
+                CHECK(all.size() == 64 * 64 - 300 - expected_map.hiddenSafe());
+        for (auto &tile: all)
+                    CHECK(tile.id == tileId(expected_map.at(tile.index % 64, tile.index / 64)));
+        thread.stop();
+                CHECK(!thread.running());
+    }
+
+    TEST_CASE ("Testing progressive reveal.")
+    {
+        Map map, expected;
+        map.resize(200, Map::Layout::Tiled);
+        map.generate(400, 8);
+        map.makeSafe(sf::Vector2u(100, 100), 9, true);
+        expected = map;
+        expected.reveal(100, 100);
+
+        /**
+         * по кускам получается то же, что и сразу, а счётчики всё время равны открытому
+         */
+        map.setProgressive(true);
+                CHECK_FALSE(map.reveal(100, 100));
+                CHECK(map.flooding());
+                CHECK(map.hiddenSafe() == 200 * 200 - 400);
+        size_t steps = 0;
+        bool counted = true;
+        while (map.step(256) != 0) {
+            size_t revealed = 0;
+            for (size_t y = 0; y != 200; y++)
+                for (size_t x = 0; x != 200; x++)
+                    revealed += map.at(x, y).first == 'r';
+            counted &= map.hiddenSafe() == 200 * 200 - 400 - revealed;
+            steps++;
+        }
+                CHECK(counted);
+                CHECK(steps > 1);
+                CHECK_FALSE(map.flooding());
+                CHECK(map.hiddenSafe() == expected.hiddenSafe());
+        bool same = true;
+        for (size_t y = 0; y != 200; y++) {
+            for (size_t x = 0; x != 200; x++)
+                same &= map.at(x, y) == expected.at(x, y);
+        }
+                CHECK(same);
+
+        /**
+         * ход по закрытой клетке доделывает заливку, прежде чем решать, закрыта ли она
+         */
+        size_t far = 0;
+        while (expected.at(far % 200, far / 200).first != 'r' || expected.at(far % 200, far / 200).second != Type::None)
+            far++;
+        auto fresh = [&] {
+            Map board;
+            board.resize(200, Map::Layout::Tiled);
+            board.generate(400, 8);
+            board.makeSafe(sf::Vector2u(100, 100), 9, true);
+            board.setProgressive(true);
+            board.reveal(100, 100);
+            return board;
+        };
+        Map board = fresh();
+                CHECK(board.flooding());
+                CHECK_FALSE(board.reveal(far % 200, far / 200));
+                CHECK_FALSE(board.flooding());
+                CHECK(board.hiddenSafe() == expected.hiddenSafe());
+
+        /**
+         * флаг на закрытую клетку тоже сначала доделывает заливку, открытую клетку отметить нельзя
+         */
+        board = fresh();
+                CHECK(board.toggleFlag(far % 200, far / 200) == 'r');
+                CHECK(board.hiddenSafe() == expected.hiddenSafe());
+
+        /**
+         * выключение доделывает заливку
+         */
+        board = fresh();
+        board.setProgressive(false);
+                CHECK_FALSE(board.flooding());
+                CHECK(board.hiddenSafe() == expected.hiddenSafe());
+    }
+
+    TEST_CASE ("Testing level of detail pyramid.")
+    {
+        Map map;
+        map.resize(37, Map::Layout::Tiled);
+        map.generate(100, 6);
+        map.makeSafe(sf::Vector2u(18, 18), 7, true);
+        map.reveal(18, 18);
+
+        /**
+         * флаг на первую закрытую клетку
+         */
+        size_t hidden = 0;
+        while (map.at(hidden % 37, hidden / 37).first != 'n')
+            hidden++;
+        map.toggleFlag(hidden % 37, hidden / 37);
+
+        LodPyramid lod;
+        lod.build(map);
+                REQUIRE(lod.levels() == 6);
+                CHECK(lod.side(0) == 19);
+                CHECK(lod.side(4) == 2);
+                CHECK(lod.side(5) == 1);
+
+        /**
+         * нижний уровень точно по клеткам, верхний - одна клетка на всю карту
+         */
+        for (size_t y = 0; y != lod.side(0); y++)
+            for (size_t x = 0; x != lod.side(0); x++) {
+                size_t revealed = 0, tiles = 0;
+                for (size_t j = y * 2; j != std::min<size_t>(37, y * 2 + 2); j++) {
+                    for (size_t i = x * 2; i != std::min<size_t>(37, x * 2 + 2); i++, tiles++)
+                        revealed += map.at(i, j).first == 'r';
+                }
+
+                        REQUIRE(lod.at(0, x, y).revealed == revealed * 255 / tiles);
+            }
+        auto &top = lod.at(5, 0, 0);
+                CHECK(top.flagged);
+                CHECK_FALSE(top.exploded);
+                CHECK(std::abs((int) top.revealed - (int) ((37 * 37 - 100 - map.hiddenSafe()) * 255 / (37 * 37))) <= 2);
+
+        /**
+         * пересчёт по изменившимся клеткам даёт ту же пирамиду, что и постройка с нуля
+         */
+        map.clearDirty();
+        map.reveal(0, 36);
+        map.toggleFlag(hidden % 37, hidden / 37);
+        map.toggleFlag(36, 36);
+        lod.clearChanged();
+        lod.update(map, map.dirty());
+                CHECK_FALSE(lod.changed(0).empty());
+                CHECK(lod.changed(5).size() <= 1);
+
+        LodPyramid fresh;
+        fresh.build(map);
+        for (size_t level = 0; level != lod.levels(); level++)
+            for (size_t y = 0; y != lod.side(level); y++)
+                for (size_t x = 0; x != lod.side(level); x++)
+                            REQUIRE(lod.at(level, x, y) == fresh.at(level, x, y));
+    }
+
+    TEST_CASE ("Testing frame scheduler.")
+    {
+        using Priority = alone::FrameScheduler::Priority;
+
+        /**
+         * с запасом бюджета выполняется всё, по приоритету, при равном - по порядку постановки
+         */
+        alone::FrameScheduler frames(std::chrono::seconds(10));
+        std::vector<int> order;
+        frames.beginFrame();
+        frames.post(Priority::Low, [&] { order.push_back(3); return true; });
+        frames.post(Priority::High, [&] { order.push_back(1); return true; });
+        frames.post(Priority::Normal, [&] { order.push_back(2); return true; });
+        frames.post(Priority::High, [&] { order.push_back(4); return true; });
+        frames.lap(alone::FrameScheduler::Phase::Update);
+                CHECK(frames.runIdle() == 4);
+                CHECK(order == std::vector<int>{1, 4, 2, 3});
+                CHECK(frames.pending() == 0);
+                CHECK(frames.stats().frames == 1);
+                CHECK(frames.stats().overBudget == 0);
+
+        /**
+         * задача, которой сейчас нельзя, остаётся в очереди и в этом кадре больше не зовётся
+         */
+        size_t tries = 0;
+        bool allowed = false;
+        frames.beginFrame();
+        frames.post(Priority::Normal, [&] { tries++; return allowed; });
+                CHECK(frames.runIdle() == 0);
+                CHECK(tries == 1);
+                CHECK(frames.stats().deferred == 1);
+                CHECK(frames.pending() == 1);
+        allowed = true;
+        frames.beginFrame();
+                CHECK(frames.runIdle() == 1);
+                CHECK(frames.pending() == 0);
+
+        /**
+         * без бюджета задачи ждут, пока не прождут MaxWait кадров, потом идут по одной за кадр
+         */
+        frames.setBudget(std::chrono::seconds(0));
+        size_t done = 0;
+        for (int i = 0; i != 3; i++)
+            frames.post(Priority::Low, [&] { done++; return true; });
+        for (size_t i = 0; i != alone::FrameScheduler::MaxWait; i++) {
+            frames.beginFrame();
+            frames.runIdle();
+        }
+                CHECK(done == 0);
+                CHECK(frames.stats().overBudget != 0);
+        frames.beginFrame();
+                CHECK(frames.runIdle() == 1);
+                CHECK(frames.stats().forced == 1);
+                CHECK(frames.stats().longestWait == alone::FrameScheduler::MaxWait);
+
+        /**
+         * старая задача с низким приоритетом обгоняет новую с высоким
+         */
+        order.clear();
+        alone::FrameScheduler aging(std::chrono::seconds(0));
+        aging.post(Priority::Low, [&] { order.push_back(1); return true; });
+        for (size_t i = 0; i != 2 * alone::FrameScheduler::AgeFrames + 1; i++) {
+            aging.beginFrame();
+            aging.runIdle();
+        }
+        aging.post(Priority::High, [&] { order.push_back(2); return true; });
+        aging.setBudget(std::chrono::seconds(10));
+        aging.beginFrame();
+                CHECK(aging.runIdle() == 2);
+                CHECK(order == std::vector<int>{1, 2});
+    }
+
+    /**
+     * состояние, которое в onLoad ждёт кадр и фоновую работу
+     */
+    struct LoadingState : alone::State {
+        std::vector<std::string> log;
+        std::atomic<bool> release = false;
+
+        void update() override {
+            log.push_back("update");
+        }
+
+        void onCreate() override {
+            log.push_back("create");
+        }
+
+        alone::Coroutine onLoad() override {
+            log.push_back("load");
+            co_await alone::nextFrame();
+            log.push_back("frame");
+            auto work = alone::background([this] {
+                while (!release)
+                    std::this_thread::yield();
+                return 42;
+            });
+            int value = co_await work;
+            log.push_back(std::to_string(value));
+        }
+
+        void onDelete() override {
+            log.push_back("delete");
+        }
+
+        void draw(sf::RenderTarget &target, sf::RenderStates states) const override {}
+    };
+
+    TEST_CASE ("Testing coroutine state loading.")
+    {
+        /**
+         * пустая сопрограмма сразу закончена, исключение изнутри выходит из resume
+         */
+        alone::Coroutine empty;
+                CHECK(empty.done());
+                CHECK(empty.resume());
+        auto failing = []() -> alone::Coroutine {
+            co_await alone::nextFrame();
+            throw std::runtime_error("load failed");
+        }();
+                CHECK_FALSE(failing.done());
+                CHECK_THROWS_AS(failing.resume(), std::runtime_error);
+                CHECK(failing.done());
+
+        /**
+         * пока onLoad ждёт, update не зовётся, а кадры идут
+         */
+        alone::StateMachine machine;
+        auto state = std::make_shared<LoadingState>();
+        machine.insert("loading", state);
+        machine.update();
+                CHECK(state->log == std::vector<std::string>{"create", "load"});
+        machine.update();
+                CHECK(state->log.back() == "frame");
+        for (int i = 0; i != 3; i++)
+            machine.update();
+                CHECK(state->log.back() == "frame");
+
+        state->release = true;
+        while (state->log.back() == "frame")
+            machine.update();
+                CHECK(state->log.back() == "42");
+        machine.update();
+                CHECK(state->log.back() == "update");
+
+        /**
+         * удаление посреди загрузки дожидается фоновой работы и не продолжает сопрограмму
+         */
+        auto pending = std::make_shared<LoadingState>();
+        machine.insert("pending", pending);
+        machine.update();
+        machine.update();
+                CHECK(pending->log.back() == "frame");
+        machine.erase("pending");
+        pending->release = true;
+        machine.update();
+                CHECK(pending->log.back() == "delete");
+                CHECK(std::find(pending->log.begin(), pending->log.end(), "42") == pending->log.end());
+    }
+}